@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "hardware/sync.h"
+#else
+#include <thread>
+#endif
+
+// Single-producer, single-consumer ring of fixed-size chunks, for handing
+// decoded data from one core to the other. Only plain atomic loads and stores
+// are used (the M0+ has no exclusive access instructions). A full ring holds
+// the producer back; an empty one holds the consumer.
+template <size_t ChunkSize, size_t NumChunks> class ChunkRing {
+  static_assert((NumChunks & (NumChunks - 1)) == 0,
+                "NumChunks must be a power of two");
+
+public:
+  struct Chunk {
+    alignas(4) std::array<uint8_t, ChunkSize> data;
+    size_t length;
+    // Set on the last chunk of a stream: the producer's result.
+    bool last;
+    int32_t status;
+  };
+
+  // Producer side. Returns a chunk to fill, or nullptr if the ring is full.
+  Chunk *try_acquire() {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == NumChunks)
+      return nullptr;
+    return &chunks_[head % NumChunks];
+  }
+  Chunk &acquire() {
+    Chunk *chunk;
+    while (!(chunk = try_acquire()))
+      wait_for_other_side();
+    return *chunk;
+  }
+  void publish() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+    notify_other_side();
+  }
+
+  // Consumer side. Returns the oldest published chunk, or nullptr if none.
+  const Chunk *try_peek() const {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail)
+      return nullptr;
+    return &chunks_[tail % NumChunks];
+  }
+  const Chunk &peek() const {
+    const Chunk *chunk;
+    while (!(chunk = try_peek()))
+      wait_for_other_side();
+    return *chunk;
+  }
+  void release() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+    notify_other_side();
+  }
+
+private:
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+  // SEV wakes both cores, and is latched if the other core isn't asleep yet.
+  static void wait_for_other_side() { __wfe(); }
+  static void notify_other_side() { __sev(); }
+#else
+  static void wait_for_other_side() { std::this_thread::yield(); }
+  static void notify_other_side() {}
+#endif
+
+  std::array<Chunk, NumChunks> chunks_{};
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+};
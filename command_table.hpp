@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Compile-time tables of panel commands, replayed in one pass by
+// `Screen::send_commands()`. Each entry is laid out as the command byte, the
+// number of parameter bytes, then the parameters.
+//
+//   constexpr auto Table = command_table(cmd(0x00, 0xef, 0x08), cmd(0x04));
+
+template <typename... Params>
+constexpr std::array<uint8_t, 2 + sizeof...(Params)> cmd(uint8_t command,
+                                                         Params... params) {
+  static_assert(sizeof...(Params) < 256);
+  return {command, static_cast<uint8_t>(sizeof...(Params)),
+          static_cast<uint8_t>(params)...};
+}
+
+template <size_t... Sizes>
+constexpr std::array<uint8_t, (Sizes + ...)>
+command_table(const std::array<uint8_t, Sizes> &...commands) {
+  std::array<uint8_t, (Sizes + ...)> table{};
+  size_t pos = 0;
+  auto append = [&](const auto &command) {
+    for (auto byte : command)
+      table[pos++] = byte;
+  };
+  (append(commands), ...);
+  return table;
+}
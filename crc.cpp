@@ -0,0 +1,8 @@
+#include "crc.hpp"
+
+#include "xip_stream.hpp"
+
+uint32_t blob_crc32(const uint8_t *data, size_t size) {
+  XipStream stream;
+  return stream.crc32(data, size);
+}
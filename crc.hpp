@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// zlib's CRC-32 of `size` bytes at `data`, as conv.py stores in Image::crc.
+// On the device the DMA sniffer computes it while the XIP streaming engine
+// reads the data, which keeps the core's hot loop out of it and the data
+// out of the XIP cache (see xip_stream.hpp); the host uses miniz.
+uint32_t blob_crc32(const uint8_t *data, size_t size);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdio>
+#include <utility>
+
+template <typename... Args>
+void debug([[maybe_unused]] const char *format,
+           [[maybe_unused]] Args &&...args) {
+#ifndef NDEBUG
+  if constexpr (sizeof...(args) == 0) {
+    puts(format);
+  } else {
+    printf(format, std::forward<Args>(args)...);
+    puts("");
+  }
+#endif
+}
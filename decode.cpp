@@ -0,0 +1,285 @@
+#include "decode.hpp"
+
+#include "crc.hpp"
+#include "frame.hpp"
+#include "xip_stream.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Collects an inflater's output in memory, refusing anything past the end.
+class BufferWriter final : public Transport {
+public:
+  BufferWriter(uint8_t *buffer, size_t size) : next_(buffer), left_(size) {}
+
+  using Transport::command;
+  void command(uint8_t, const uint8_t *, size_t) override {}
+  void start_data(const uint8_t *data, size_t length) override {
+    length = clip(length);
+    std::memcpy(next_, data, length);
+    advance(length);
+  }
+  void start_fill(uint8_t value, size_t length) override {
+    length = clip(length);
+    std::memset(next_, value, length);
+    advance(length);
+  }
+  [[nodiscard]] bool busy() const override { return false; }
+  void wait() override {}
+  // Whether exactly `size` bytes arrived.
+  [[nodiscard]] bool full() const { return !left_ && !overflow_; }
+
+private:
+  size_t clip(size_t length) {
+    overflow_ = overflow_ || length > left_;
+    return std::min(length, left_);
+  }
+  void advance(size_t length) {
+    next_ += length;
+    left_ -= length;
+  }
+
+  uint8_t *next_;
+  size_t left_;
+  bool overflow_ = false;
+};
+
+template <Codec C>
+int32_t inflate(Inflater &inflater, const Image &image, const uint8_t *data,
+                size_t size, Transport &out) {
+  if constexpr (C == Codec::Deflate)
+    return inflater.inflate_raw(data, size, image.dictionary,
+                                image.dictionary_size, out);
+  else
+    return inflater.inflate(data, size, out);
+}
+
+const uint8_t *band_data(const Image &image, size_t band) {
+  return image.compressed_data + image.band_offsets[band];
+}
+
+size_t band_size(const Image &image, size_t band) {
+  return image.band_offsets[band + 1] - image.band_offsets[band];
+}
+
+#ifdef FRAME_XIP_STREAM
+uint32_t band_stages[2][BandStageBytes / 4];
+bool band_streaming = true;
+#endif
+
+// Reads the bands of an image a decoder visits, in order, staging each in
+// SRAM while the one before is decoded if FRAME_XIP_STREAM allows.
+class BandReader {
+public:
+  BandReader(const Image &image, size_t first, size_t step)
+      : image_(image), step_(step) {
+    stage(first);
+  }
+
+  // The compressed data of `band`, which must be the next visited.
+  const uint8_t *read(size_t band) {
+#ifdef FRAME_XIP_STREAM
+    if (band == staged_) {
+      stream_.wait();
+      return staged_data_;
+    }
+#endif
+    return band_data(image_, band);
+  }
+  // Moves on from `band` to the next.
+  void next(size_t band) { stage(band + step_); }
+
+private:
+#ifdef FRAME_XIP_STREAM
+  static constexpr size_t NoBand = ~size_t{0};
+
+  void stage(size_t band) {
+    staged_ = NoBand;
+    if (!band_streaming || !stream_.claimed() || band >= image_.num_bands)
+      return;
+    const auto *data = band_data(image_, band);
+    const auto size = band_size(image_, band);
+    if (!XipStream::streamable(data) || size + 3 > BandStageBytes)
+      return;
+    // The band being decoded is in the other stage.
+    current_ ^= 1;
+    staged_data_ = stream_.start(data, size, band_stages[current_]);
+    staged_ = band;
+  }
+
+  XipStream stream_;
+  size_t staged_ = NoBand;
+  const uint8_t *staged_data_ = nullptr;
+  size_t current_ = 0;
+#else
+  void stage(size_t) {}
+#endif
+
+  const Image &image_;
+  size_t step_;
+};
+
+template <typename BandDecoder>
+BandDecoder find(const BandDecoder (&decoders)[NumCodecs], Codec codec) {
+  return decoder_linked(codec) ? decoders[static_cast<size_t>(codec)]
+                               : nullptr;
+}
+
+} // namespace
+
+#ifdef FRAME_XIP_STREAM
+void set_band_streaming(bool on) { band_streaming = on; }
+#endif
+
+size_t band_rows(const Image &image, size_t band) {
+  return std::min<size_t>(image.band_rows,
+                          frame::Height - band * image.band_rows);
+}
+
+bool image_intact(const Image &image) {
+  if (!decoder_linked(image.codec) || !image.num_bands || !image.band_rows ||
+      size_t{image.band_rows} * (image.num_bands - 1) >= frame::Height ||
+      size_t{image.band_rows} * image.num_bands < frame::Height ||
+      image.band_offsets[0] != 0 ||
+      image.band_offsets[image.num_bands] != image.compressed_size)
+    return false;
+  // band_size() takes each band's end as no earlier than its start.
+  for (size_t band = 0; band < image.num_bands; ++band)
+    if (image.band_offsets[band] > image.band_offsets[band + 1])
+      return false;
+  return blob_crc32(image.compressed_data, image.compressed_size) ==
+         image.crc;
+}
+
+// The decoders' state is named through IfLinked<..., C> below, which
+// depends on C, so discarded branches don't see it as Unlinked.
+template <Codec C>
+bool FrameDecoder::decode_band_as(const Image &image, size_t band,
+                                  const uint8_t *data, uint8_t *rows) {
+  const auto size = band_size(image, band);
+  const auto num_rows = band_rows(image, band);
+  if constexpr (C == Codec::RowLz) {
+    IfLinked<RowLzDecoder, C> &row_lz = row_lz_;
+    return row_lz.decode(data, size, num_rows, rows);
+  } else if constexpr (C == Codec::Rle) {
+    IfLinked<RleDecoder, C> &rle = rle_;
+    return rle.decode(data, size, num_rows, rows);
+  } else {
+    IfLinked<Inflater, C> &inflater = inflater_;
+    IfLinked<RowUnfilter, C> &unfilter = unfilter_;
+    if (image.filters) {
+      BufferWriter dest(rows, num_rows * frame::RowBytes);
+      unfilter.start(image, dest);
+      return inflate<C>(inflater, image, data, size, unfilter) >= 0 &&
+             dest.full();
+    }
+    // Packed bands inflate into the tail of their rows and unpack forwards.
+    const auto bytes = num_rows * frame::RowBytes;
+    const auto unpacked = image.format == PixelFormat::Packed3
+                              ? packed3::packed_size(bytes)
+                              : bytes;
+    BufferWriter dest(rows + bytes - unpacked, unpacked);
+    if (inflate<C>(inflater, image, data, size, dest) < 0 || !dest.full())
+      return false;
+    if (image.format == PixelFormat::Packed3)
+      packed3::unpack_in_place(rows, bytes);
+    return true;
+  }
+}
+
+const FrameDecoder::BandDecoder FrameDecoder::Decoders[NumCodecs] = {
+    linked<Codec::Zlib>(), linked<Codec::Deflate>(), linked<Codec::RowLz>(),
+    linked<Codec::Rle>()};
+
+bool FrameDecoder::decode_band(const Image &image, size_t band,
+                               uint8_t *rows) {
+  return decode_band(image, band, band_data(image, band), rows);
+}
+
+bool FrameDecoder::decode_band(const Image &image, size_t band,
+                               const uint8_t *data, uint8_t *rows) {
+  const auto decoder = find(Decoders, image.codec);
+  return decoder && (this->*decoder)(image, band, data, rows);
+}
+
+bool FrameDecoder::decode(const Image &image, uint8_t *frame, size_t first,
+                          size_t step) {
+  bool ok = true;
+  BandReader reader(image, first, step);
+  for (size_t band = first; band < image.num_bands; band += step) {
+    auto *rows = frame + band * image.band_rows * frame::RowBytes;
+    const auto *data = reader.read(band);
+    reader.next(band);
+    ok = decode_band(image, band, data, rows) && ok;
+  }
+  return ok;
+}
+
+bool decode_frame(const Image &image, uint8_t *frame) {
+  static FrameDecoder decoder;
+  return decoder.decode(image, frame);
+}
+
+int32_t StreamDecoder::decode(const Image &image, size_t first, size_t count,
+                              Transport &out) {
+  int32_t total = 0;
+  const auto end = std::min<size_t>(first + count, image.num_bands);
+  BandReader reader(image, first, 1);
+  for (auto band = first; band < end; ++band) {
+    const auto *data = reader.read(band);
+    if (band + 1 < end)
+      reader.next(band);
+    // A band that over- or underproduces is corrupt even if the total
+    // still comes out at a frame.
+    const auto sent = decode_band(image, band, data, out);
+    if (sent != static_cast<int32_t>(band_rows(image, band) * frame::RowBytes))
+      return -1;
+    total += sent;
+  }
+  return total;
+}
+
+template <Codec C>
+int32_t StreamDecoder::decode_band_as(const Image &image, size_t band,
+                                      const uint8_t *data, Transport &out) {
+  const auto size = band_size(image, band);
+  if constexpr (C == Codec::RowLz) {
+    IfLinked<RowLzDecoder, C> &row_lz = row_lz_;
+    return row_lz.decode(data, size, band_rows(image, band), out);
+  } else if constexpr (C == Codec::Rle) {
+    IfLinked<RleDecoder, C> &rle = rle_;
+    return rle.decode(data, size, band_rows(image, band), out);
+  } else {
+    IfLinked<Inflater, C> &inflater = inflater_;
+    if (image.filters) {
+      IfLinked<RowUnfilter, C> &unfilter = unfilter_;
+      unfilter.start(image, out);
+      const auto stored = inflate<C>(inflater, image, data, size, unfilter);
+      return stored < 0
+                 ? stored
+                 : stored / static_cast<int32_t>(unfilter.row_bytes()) *
+                       static_cast<int32_t>(frame::RowBytes);
+    }
+    if (image.format != PixelFormat::Packed3)
+      return inflate<C>(inflater, image, data, size, out);
+    IfLinked<Packed3Unpacker, C> &unpacker = unpacker_;
+    unpacker.set_output(out);
+    auto packed = inflate<C>(inflater, image, data, size, unpacker);
+    return packed < 0
+               ? packed
+               : packed / static_cast<int32_t>(packed3::GroupPackedBytes) *
+                     static_cast<int32_t>(packed3::GroupBytes);
+  }
+}
+
+const StreamDecoder::BandDecoder StreamDecoder::Decoders[NumCodecs] = {
+    linked<Codec::Zlib>(), linked<Codec::Deflate>(), linked<Codec::RowLz>(),
+    linked<Codec::Rle>()};
+
+int32_t StreamDecoder::decode_band(const Image &image, size_t band,
+                                   const uint8_t *data, Transport &out) {
+  const auto decoder = find(Decoders, image.codec);
+  return decoder ? (this->*decoder)(image, band, data, out) : -1;
+}
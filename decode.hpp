@@ -0,0 +1,138 @@
+#pragma once
+
+#include "filter.hpp"
+#include "images.hpp"
+#include "packed3.hpp"
+#include "rle.hpp"
+#include "row_lz.hpp"
+#include "stream_inflate.hpp"
+#include "transport.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// The deflate decoder the image decoders use.
+using Inflater = StreamInflater;
+
+// Whether the decoder for `codec` is linked in: only those the generated
+// images use, unless FRAME_ALL_DECODERS asks for every one (as the host
+// benches do, to compare codecs). Images in other codecs fail to decode.
+constexpr bool decoder_linked(Codec codec) {
+  const auto index = static_cast<size_t>(codec);
+#ifdef FRAME_ALL_DECODERS
+  return index < NumCodecs;
+#else
+  return index < NumCodecs && UsesCodec[index];
+#endif
+}
+
+// Stands in for the state of decoders that aren't linked, so they take no
+// RAM either.
+struct Unlinked {};
+// `Decoder` if it's needed for any of `Codecs`, otherwise Unlinked.
+template <typename Decoder, Codec... Codecs>
+using IfLinked = std::conditional_t<(decoder_linked(Codecs) || ...), Decoder,
+                                    Unlinked>;
+
+#ifdef FRAME_XIP_STREAM
+// Decoding a flash image, each band is copied into one of two buffers of
+// this size by the XIP streaming engine while the band before is decoded
+// from the other, so the compressed data never passes through (and evicts)
+// the XIP cache. Bands too big for a buffer are read in place. The buffers
+// and the engine are shared: a decoder that finds the other core using them
+// reads in place too.
+constexpr size_t BandStageBytes = 10 * 1024;
+// Turns the staging off or back on, for inflate_bench to compare.
+void set_band_streaming(bool on);
+#endif
+
+// Rows in `band` of `image`; the last band may be short.
+size_t band_rows(const Image &image, size_t band);
+
+// Whether `image` is as the generator wrote it: its band table covers the
+// frame, its codec's decoder is linked and its compressed data matches its
+// CRC. On the device the DMA sniffer makes the CRC next to nothing beside a
+// refresh (see crc.hpp), so it's checked before each one. Raw deflate images
+// rely on it alone, having no Adler-32.
+bool image_intact(const Image &image);
+
+// Decodes images, or any of their bands, into memory in the panel's nibble
+// layout. Holds the linked decoders' state (around 50KB with inflate, nothing
+// on the heap), so cores decoding at once need one each.
+class FrameDecoder {
+public:
+  // Decodes one band into `rows`, which must be word aligned and
+  // band_rows() * frame::RowBytes long. Returns false if it's corrupt.
+  bool decode_band(const Image &image, size_t band, uint8_t *rows);
+  // Decodes every `step`th band from `first` into its place in `frame`, so
+  // two cores can share a frame with (0, 2) and (1, 2). A corrupt band is
+  // skipped and the rest still decoded; returns false if there were any.
+  bool decode(const Image &image, uint8_t *frame, size_t first = 0,
+              size_t step = 1);
+
+private:
+  using BandDecoder = bool (FrameDecoder::*)(const Image &, size_t,
+                                             const uint8_t *, uint8_t *);
+  bool decode_band(const Image &image, size_t band, const uint8_t *data,
+                   uint8_t *rows);
+  // `data` is the band's compressed data, wherever it's been read to.
+  template <Codec C>
+  bool decode_band_as(const Image &image, size_t band, const uint8_t *data,
+                      uint8_t *rows);
+  // Instantiating decode_band_as() is what links a decoder, so it's only
+  // done for the linked ones.
+  template <Codec C> static constexpr BandDecoder linked() {
+    if constexpr (decoder_linked(C))
+      return &FrameDecoder::decode_band_as<C>;
+    else
+      return nullptr;
+  }
+  // Indexed by Codec; null where the decoder isn't linked.
+  static const BandDecoder Decoders[NumCodecs];
+
+  IfLinked<Inflater, Codec::Zlib, Codec::Deflate> inflater_;
+  IfLinked<RowUnfilter, Codec::Zlib, Codec::Deflate> unfilter_;
+  IfLinked<RowLzDecoder, Codec::RowLz> row_lz_;
+  IfLinked<RleDecoder, Codec::Rle> rle_;
+};
+
+// Decodes a whole image into `frame`, in the panel's nibble layout. `frame`
+// must be word aligned and frame::Bytes long. Returns false if the image
+// didn't decode to a full frame.
+bool decode_frame(const Image &image, uint8_t *frame);
+
+// Decodes an image straight to a transport in the panel's nibble layout,
+// whatever codec and format it's stored in. Returns the number of bytes sent,
+// or -1 on a corrupt image.
+class StreamDecoder {
+public:
+  int32_t decode(const Image &image, Transport &out) {
+    return decode(image, 0, image.num_bands, out);
+  }
+  // Sends just `count` bands from `first`.
+  int32_t decode(const Image &image, size_t first, size_t count,
+                 Transport &out);
+
+private:
+  using BandDecoder = int32_t (StreamDecoder::*)(const Image &, size_t,
+                                                 const uint8_t *, Transport &);
+  int32_t decode_band(const Image &image, size_t band, const uint8_t *data,
+                      Transport &out);
+  template <Codec C>
+  int32_t decode_band_as(const Image &image, size_t band, const uint8_t *data,
+                         Transport &out);
+  template <Codec C> static constexpr BandDecoder linked() {
+    if constexpr (decoder_linked(C))
+      return &StreamDecoder::decode_band_as<C>;
+    else
+      return nullptr;
+  }
+  static const BandDecoder Decoders[NumCodecs];
+
+  IfLinked<Inflater, Codec::Zlib, Codec::Deflate> inflater_;
+  IfLinked<RowUnfilter, Codec::Zlib, Codec::Deflate> unfilter_;
+  IfLinked<Packed3Unpacker, Codec::Zlib, Codec::Deflate> unpacker_;
+  IfLinked<RowLzDecoder, Codec::RowLz> row_lz_;
+  IfLinked<RleDecoder, Codec::Rle> rle_;
+};
@@ -0,0 +1,112 @@
+#include "filter.hpp"
+
+#include "packed3.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Spreads a byte's bits three apart, so three bit planes' bytes interleave
+// into the packed3 word for the same eight pixels.
+constexpr auto SpreadTable = [] {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < table.size(); ++i) {
+    for (uint32_t bit = 0; bit < 8; ++bit)
+      table[i] |= ((i >> bit) & 1) << (3 * bit);
+  }
+  return table;
+}();
+
+constexpr size_t PlaneBytes = frame::Width / 8;
+
+} // namespace
+
+void RowUnfilter::start(const Image &image, Transport &out) {
+  out_ = &out;
+  const bool packed = image.format == PixelFormat::Packed3;
+  row_bytes_ = packed ? packed3::packed_size(frame::RowBytes) : frame::RowBytes;
+  planes_ = packed && (image.filters & filter::Planes);
+  up_mask_ = (image.filters & filter::Up) ? 0xff : 0;
+  const bool remap = image.palette && (image.filters & filter::Remap);
+  const auto colour = [&](unsigned index) {
+    return remap ? image.palette[index & 7] : index;
+  };
+  for (unsigned i = 0; i < pairs_.size(); ++i) {
+    const auto hi = packed ? (i >> 3) & 7 : i >> 4;
+    const auto lo = packed ? i & 7 : i & 15;
+    pairs_[i] = static_cast<uint8_t>(colour(hi) << 4 | colour(lo));
+  }
+  above_.fill(0);
+  partial_length_ = 0;
+}
+
+void RowUnfilter::send_row(const uint8_t *stored) {
+  auto &row = buffers_[next_buffer_];
+  next_buffer_ ^= 1;
+  const auto mask = up_mask_;
+  auto *above = above_.data();
+  if (row_bytes_ == frame::RowBytes) {
+    for (size_t x = 0; x < frame::RowBytes; ++x) {
+      above[x] = static_cast<uint8_t>((above[x] & mask) ^ stored[x]);
+      row[x] = pairs_[above[x]];
+    }
+  } else {
+    // Each group of eight pixels is three stored bytes: consecutive ones,
+    // or one from each bit plane.
+    const size_t stride = planes_ ? PlaneBytes : 1;
+    const size_t step = planes_ ? 1 : packed3::GroupPackedBytes;
+    auto *out = row.data();
+    for (size_t in = 0; in < row_bytes_ / packed3::GroupPackedBytes * step;
+         in += step, out += packed3::GroupBytes) {
+      uint32_t bytes[3];
+      for (size_t i = 0; i < 3; ++i) {
+        auto &byte = above[in + i * stride];
+        byte = static_cast<uint8_t>((byte & mask) ^ stored[in + i * stride]);
+        bytes[i] = byte;
+      }
+      const uint32_t bits =
+          planes_ ? SpreadTable[bytes[0]] << 2 | SpreadTable[bytes[1]] << 1 |
+                        SpreadTable[bytes[2]]
+                  : bytes[0] << 16 | bytes[1] << 8 | bytes[2];
+      const uint32_t word = uint32_t{pairs_[bits >> 18]} |
+                            uint32_t{pairs_[(bits >> 12) & 63]} << 8 |
+                            uint32_t{pairs_[(bits >> 6) & 63]} << 16 |
+                            uint32_t{pairs_[bits & 63]} << 24;
+      std::memcpy(__builtin_assume_aligned(out, 4), &word, sizeof(word));
+    }
+  }
+  // The downstream start_data() waits out the last row, which is the one
+  // in the *other* buffer, so this one was free.
+  out_->start_data(row.data(), frame::RowBytes);
+}
+
+void RowUnfilter::start_data(const uint8_t *data, size_t length) {
+  while (length) {
+    if (partial_length_ || length < row_bytes_) {
+      const auto take = std::min(length, row_bytes_ - partial_length_);
+      std::copy_n(data, take, partial_.data() + partial_length_);
+      partial_length_ += take;
+      data += take;
+      length -= take;
+      if (partial_length_ == row_bytes_) {
+        send_row(partial_.data());
+        partial_length_ = 0;
+      }
+      continue;
+    }
+    send_row(data);
+    data += row_bytes_;
+    length -= row_bytes_;
+  }
+}
+
+void RowUnfilter::start_fill(uint8_t value, size_t length) {
+  std::array<uint8_t, 48> block;
+  block.fill(value);
+  while (length) {
+    auto piece = std::min(length, block.size());
+    start_data(block.data(), piece);
+    length -= piece;
+  }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "frame.hpp"
+#include "images.hpp"
+#include "transport.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Sits between the inflater and another transport and undoes an image's
+// filter:: flags, sending rows on in the panel's nibble layout. Each row is
+// un-XORed, de-planed, unpacked and remapped in a single pass, into two
+// row buffers in turn so one can be filled while the other is sent.
+class RowUnfilter final : public Transport {
+public:
+  // Starts a band of `image`; `out` is where its rows go.
+  void start(const Image &image, Transport &out);
+
+  using Transport::command;
+  void command(uint8_t command, const uint8_t *params,
+               size_t length) override {
+    out_->command(command, params, length);
+  }
+  void start_data(const uint8_t *data, size_t length) override;
+  void start_fill(uint8_t value, size_t length) override;
+  void open_data() override { out_->open_data(); }
+  void close_data() override { out_->close_data(); }
+  [[nodiscard]] bool busy() const override { return out_->busy(); }
+  void wait() override { out_->wait(); }
+
+  // Bytes in each row as stored, before unfiltering.
+  [[nodiscard]] size_t row_bytes() const { return row_bytes_; }
+
+private:
+  void send_row(const uint8_t *stored);
+
+  Transport *out_ = nullptr;
+  size_t row_bytes_ = frame::RowBytes;
+  bool planes_ = false;
+  // ANDed with the row above before XORing it in, so 0 without filter::Up.
+  uint8_t up_mask_ = 0;
+  // Stored indices to nibble-layout bytes: a pair of 3-bit pixels for
+  // Packed3, a whole byte for Nibble4.
+  std::array<uint8_t, 256> pairs_{};
+  // The previous row, once un-XORed, in its stored layout.
+  std::array<uint8_t, frame::RowBytes> above_{};
+  std::array<uint8_t, frame::RowBytes> partial_{};
+  size_t partial_length_ = 0;
+  size_t next_buffer_ = 0;
+  alignas(4) std::array<std::array<uint8_t, frame::RowBytes>, 2> buffers_{};
+};
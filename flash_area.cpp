@@ -0,0 +1,107 @@
+#include "flash_area.hpp"
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "image_store.hpp"
+
+#include "hardware/flash.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/structs/sio.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+static_assert(store::Offset + store::Size <= DeviceFlash::Offset,
+              "the image store and runtime state overlap");
+static_assert(DeviceFlash::Offset + DeviceFlash::Size <= PICO_FLASH_SIZE_BYTES,
+              "runtime state is past the end of flash");
+
+namespace {
+
+// Sent through the inter-core FIFO to stop core 1, and back once it has.
+// Image and frame pointers are never odd, so can't be mistaken for these.
+constexpr uint32_t Park = 0xf1a5'4001;
+constexpr uint32_t Parked = 0xf1a5'4003;
+
+// What core 1 sent before it saw Park, such as a decode's result, kept in
+// order for core1_fifo_pop(). Core 1 only answers what core 0 asks, so it
+// never has more outstanding than the FIFO holds.
+std::array<uint32_t, 8> stash;
+size_t stash_first = 0;
+size_t stash_size = 0;
+
+// Runs `write` with core 1 stopped and interrupts off.
+template <typename Write> void with_flash_to_ourselves(Write write) {
+#ifdef FRAME_DUAL_CORE
+  multicore_fifo_push_blocking(Park);
+  for (uint32_t word; (word = multicore_fifo_pop_blocking()) != Parked;) {
+    if (stash_size < stash.size())
+      stash[(stash_first + stash_size++) % stash.size()] = word;
+  }
+#endif
+  const auto interrupts = save_and_disable_interrupts();
+  write();
+  restore_interrupts(interrupts);
+#ifdef FRAME_DUAL_CORE
+  // Anything lets it go.
+  multicore_fifo_push_blocking(Parked);
+#endif
+}
+
+} // namespace
+
+uint32_t core1_fifo_pop() {
+  if (!stash_size)
+    return multicore_fifo_pop_blocking();
+  const auto word = stash[stash_first];
+  stash_first = (stash_first + 1) % stash.size();
+  --stash_size;
+  return word;
+}
+
+const uint8_t *DeviceFlash::data() const {
+  return reinterpret_cast<const uint8_t *>(XIP_BASE + Offset);
+}
+
+void DeviceFlash::erase(size_t offset) {
+  with_flash_to_ourselves(
+      [&] { flash_range_erase(Offset + offset, FLASH_SECTOR_SIZE); });
+}
+
+void DeviceFlash::program(size_t offset, const uint8_t *data, size_t size) {
+  // Flash is programmed a page at a time; erased bytes (0xff) program to
+  // no change, so pad with those.
+  alignas(4) std::array<uint8_t, FLASH_PAGE_SIZE> page;
+  while (size) {
+    const auto page_offset = offset % FLASH_PAGE_SIZE;
+    const auto length = std::min(size, FLASH_PAGE_SIZE - page_offset);
+    page.fill(0xff);
+    std::memcpy(page.data() + page_offset, data, length);
+    with_flash_to_ourselves([&] {
+      flash_range_program(Offset + offset - page_offset, page.data(),
+                          FLASH_PAGE_SIZE);
+    });
+    offset += length;
+    data += length;
+    size -= length;
+  }
+}
+
+// In RAM, as it runs while flash is being written.
+bool __not_in_flash_func(core1_parked)(uint32_t word) {
+  if (word != Park)
+    return false;
+  const auto interrupts = save_and_disable_interrupts();
+  while (!(sio_hw->fifo_st & SIO_FIFO_ST_RDY_BITS)) {
+  }
+  sio_hw->fifo_wr = Parked;
+  __sev();
+  while (!(sio_hw->fifo_st & SIO_FIFO_ST_VLD_BITS))
+    __wfe();
+  (void)sio_hw->fifo_rd;
+  restore_interrupts(interrupts);
+  return true;
+}
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Flash that runtime state is kept in, with NOR flash's rules: erasing a
+// sector sets all its bits, and programming only clears them, so bytes
+// already programmed can only be changed by erasing their sector.
+class FlashArea {
+public:
+  static constexpr size_t SectorBytes = 4096;
+
+  virtual ~FlashArea() = default;
+
+  [[nodiscard]] virtual size_t size() const = 0;
+  // The contents, read in place.
+  [[nodiscard]] virtual const uint8_t *data() const = 0;
+  // Erases the sector starting `offset` bytes in.
+  virtual void erase(size_t offset) = 0;
+  // Programs `size` bytes at `offset`, which needn't be page aligned.
+  virtual void program(size_t offset, const uint8_t *data, size_t size) = 0;
+};
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+// The last 64KB of the Pico's flash, above the image store (see
+// image_store.hpp). Writing it stops core 1 (with FRAME_DUAL_CORE) and
+// interrupts, as nothing may run from flash meanwhile; core 1 must pass
+// each word it takes from the inter-core FIFO to core1_parked() first, and
+// get back to the FIFO without core 0's help, as a write waits for it
+// there. Core 0 takes core 1's replies with core1_fifo_pop().
+class DeviceFlash final : public FlashArea {
+public:
+  static constexpr uint32_t Offset = 0x1f0000;
+  static constexpr uint32_t Size = 0x10000;
+
+  [[nodiscard]] size_t size() const override { return Size; }
+  [[nodiscard]] const uint8_t *data() const override;
+  void erase(size_t offset) override;
+  void program(size_t offset, const uint8_t *data, size_t size) override;
+};
+
+// If `word` is DeviceFlash asking core 1 to stop, stops in RAM until the
+// write's done and returns true; otherwise returns false.
+bool core1_parked(uint32_t word);
+// Takes the next word core 1 sent through the inter-core FIFO, for core 0
+// in place of multicore_fifo_pop_blocking(). A write waits for core 1 on
+// the FIFO as well, keeping whatever else it finds there for this.
+uint32_t core1_fifo_pop();
+#endif
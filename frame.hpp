@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+// Panel geometry, shared by the firmware and the host builds. Frames are
+// stored 4 bits per pixel, two pixels to a byte, left pixel in the top nibble.
+namespace frame {
+
+constexpr auto Width = 600;
+constexpr auto Height = 448;
+constexpr size_t RowBytes = Width / 2;
+constexpr size_t Bytes = RowBytes * Height;
+
+} // namespace frame
@@ -0,0 +1,134 @@
+// Runs many thousands of chunks through a ChunkRing between two threads,
+// with random delays on each side: first a slow consumer, so the producer
+// keeps finding the ring full, then a slow producer, so the consumer keeps
+// finding it empty, then both at random. Checks every chunk arrives once, in
+// order, with its contents, length, `last` and `status` intact, and that
+// both kinds of stall actually happened.
+//   chunk_ring_test [chunks]
+#include "chunk_ring.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace {
+
+constexpr size_t ChunkSize = 16;
+constexpr size_t NumChunks = 4;
+using Ring = ChunkRing<ChunkSize, NumChunks>;
+// Each stream is this many chunks, the last marked `last`.
+constexpr uint32_t StreamChunks = 7;
+
+enum class Phase { SlowConsumer, SlowProducer, Random };
+
+Phase phase(uint32_t sequence, uint32_t chunks) {
+  if (sequence < chunks / 3)
+    return Phase::SlowConsumer;
+  return sequence < 2 * chunks / 3 ? Phase::SlowProducer : Phase::Random;
+}
+
+// Spins for a random while, up to `most` iterations, sometimes yielding.
+void delay(std::mt19937 &random, uint32_t most) {
+  const auto spins = random() % (most + 1);
+  for (volatile uint32_t i = 0; i < spins; ++i) {
+  }
+  if (most && random() % 8 == 0)
+    std::this_thread::yield();
+}
+
+// How long each side may dawdle per chunk in `phase`.
+uint32_t producer_delay(Phase phase) {
+  return phase == Phase::SlowProducer ? 4000
+         : phase == Phase::Random     ? 500
+                                      : 0;
+}
+uint32_t consumer_delay(Phase phase) {
+  return phase == Phase::SlowConsumer ? 4000
+         : phase == Phase::Random     ? 500
+                                      : 0;
+}
+
+size_t length_of(uint32_t sequence) { return sequence % ChunkSize + 1; }
+
+uint8_t byte_of(uint32_t sequence, size_t i) {
+  return static_cast<uint8_t>(sequence * 31 + i * 7);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const long chunks_arg = argc > 1 ? std::atol(argv[1]) : 30000;
+  if (chunks_arg < 3 * static_cast<long>(StreamChunks)) {
+    std::printf("chunks must be at least %u\n", 3 * StreamChunks);
+    return EXIT_FAILURE;
+  }
+  const auto chunks = static_cast<uint32_t>(chunks_arg);
+  static Ring ring;
+  size_t full_stalls = 0;
+  size_t empty_stalls = 0;
+
+  std::thread producer([&] {
+    std::mt19937 random(1);
+    for (uint32_t sequence = 0; sequence < chunks; ++sequence) {
+      delay(random, producer_delay(phase(sequence, chunks)));
+      auto *chunk = ring.try_acquire();
+      if (!chunk) {
+        ++full_stalls;
+        chunk = &ring.acquire();
+      }
+      // Garbage first, so a chunk the consumer still holds would show it.
+      chunk->data.fill(0xee);
+      chunk->length = length_of(sequence);
+      for (size_t i = 0; i < chunk->length; ++i)
+        chunk->data[i] = byte_of(sequence, i);
+      std::memcpy(chunk->data.data() + ChunkSize - 4, &sequence, 4);
+      chunk->last = sequence % StreamChunks == StreamChunks - 1;
+      chunk->status = chunk->last ? static_cast<int32_t>(sequence) : -1;
+      ring.publish();
+    }
+  });
+
+  // Every chunk is taken even after a bad one, so the producer finishes.
+  size_t bad = 0;
+  std::mt19937 random(2);
+  for (uint32_t sequence = 0; sequence < chunks; ++sequence) {
+    delay(random, consumer_delay(phase(sequence, chunks)));
+    const auto *chunk = ring.try_peek();
+    if (!chunk) {
+      ++empty_stalls;
+      chunk = &ring.peek();
+    }
+    uint32_t carried;
+    std::memcpy(&carried, chunk->data.data() + ChunkSize - 4, 4);
+    const bool last = sequence % StreamChunks == StreamChunks - 1;
+    bool intact = carried == sequence &&
+                  chunk->length == length_of(sequence) &&
+                  chunk->last == last &&
+                  chunk->status ==
+                      (last ? static_cast<int32_t>(sequence) : -1);
+    // The sequence number overlays the tail of the longest chunks.
+    for (size_t i = 0; i < chunk->length && i < ChunkSize - 4; ++i)
+      intact = intact && chunk->data[i] == byte_of(sequence, i);
+    if (!intact && ++bad <= 10) {
+      std::printf("chunk %u arrived as chunk %u (length %zu, last %d, "
+                  "status %d)\n",
+                  sequence, carried, chunk->length, chunk->last,
+                  chunk->status);
+    }
+    ring.release();
+  }
+  producer.join();
+  bool ok = !bad;
+
+  std::printf("%u chunks: the producer found the ring full %zu times, the "
+              "consumer found it empty %zu times\n",
+              chunks, full_stalls, empty_stalls);
+  if (!full_stalls || !empty_stalls) {
+    std::printf("the ring never stalled both ways\n");
+    ok = false;
+  }
+  std::printf(ok ? "chunk_ring: all checks passed\n" : "chunk_ring: FAILED\n");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
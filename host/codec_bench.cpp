@@ -0,0 +1,183 @@
+// Compares each codec, and the per-image best-of the firmware embeds, on every
+// image: compressed size, and the time to decode a whole frame on one thread
+// and with its bands split between two. Also checks that every codec decodes
+// to the same frame and that corrupt images, or bands of the wrong size, are
+// caught.
+#include "decode.hpp"
+#include "frame.hpp"
+#include "images.hpp"
+#include "recording_transport.hpp"
+#include "rle.hpp"
+#include "row_lz.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+extern const Image ZlibImages[Image::NumImages];
+extern const Image RowLzImages[Image::NumImages];
+extern const Image RleImages[Image::NumImages];
+
+namespace {
+
+template <typename Decode> long long time_us(int rounds, Decode decode) {
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round)
+    decode();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         rounds;
+}
+
+// Decodes alternate bands on two threads, as the two cores would.
+bool decode_split(const Image &image, uint8_t *frame) {
+  static FrameDecoder decoders[2];
+  bool odd_ok = false;
+  std::thread odd([&] { odd_ok = decoders[1].decode(image, frame, 1, 2); });
+  const bool even_ok = decoders[0].decode(image, frame, 0, 2);
+  odd.join();
+  return even_ok && odd_ok;
+}
+
+// Appends raw deflate stored blocks carrying `bytes` zeros, the last final.
+void append_stored(std::vector<uint8_t> &out, size_t bytes) {
+  do {
+    const auto length = static_cast<uint16_t>(std::min<size_t>(bytes, 0xffff));
+    bytes -= length;
+    out.insert(out.end(), {static_cast<uint8_t>(!bytes),
+                           static_cast<uint8_t>(length & 0xff),
+                           static_cast<uint8_t>(length >> 8),
+                           static_cast<uint8_t>(~length & 0xff),
+                           static_cast<uint8_t>(~length >> 8)});
+    out.insert(out.end(), length, 0);
+  } while (bytes);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+  std::vector<uint8_t> expected(frame::Bytes);
+  std::vector<uint8_t> decoded(frame::Bytes);
+  bool ok = true;
+  struct Table {
+    const char *name;
+    const Image *images;
+    size_t total;
+  };
+  Table tables[] = {{"zlib", ZlibImages, 0},
+                    {"row LZ", RowLzImages, 0},
+                    {"RLE", RleImages, 0},
+                    {"best-of", Image::Images, 0}};
+
+  std::printf("%-36s %-8s %14s %9s %9s\n", "image", "codec", "bytes", "us",
+              "2T us");
+  for (size_t i = 0; i < Image::NumImages; ++i) {
+    const auto &zlib = ZlibImages[i];
+    if (!decode_frame(zlib, expected.data())) {
+      std::printf("%s: zlib doesn't decode\n", zlib.name);
+      ok = false;
+      continue;
+    }
+    for (auto &table : tables) {
+      const auto &image = table.images[i];
+      std::fill(decoded.begin(), decoded.end(), 0);
+      if (!decode_frame(image, decoded.data()) || expected != decoded) {
+        std::printf("%s: %s output doesn't match zlib\n", image.name,
+                    table.name);
+        ok = false;
+        continue;
+      }
+      std::fill(decoded.begin(), decoded.end(), 0);
+      if (!decode_split(image, decoded.data()) || expected != decoded) {
+        std::printf("%s: %s split decode doesn't match\n", image.name,
+                    table.name);
+        ok = false;
+      }
+      auto us = time_us(rounds, [&] { decode_frame(image, decoded.data()); });
+      auto split_us =
+          time_us(rounds, [&] { decode_split(image, decoded.data()); });
+      std::printf("%-36s %-8s %7zu %5.1f%% %9lld %9lld\n",
+                  &table == tables ? image.name : "", table.name,
+                  image.compressed_size,
+                  100.0 * image.compressed_size / frame::Bytes, us, split_us);
+      table.total += image.compressed_size;
+    }
+
+    // A truncated stream must be caught, not read past, and so must a
+    // corrupt row LZ one (RLE has only the CRC).
+    const auto &row_lz = RowLzImages[i];
+    const auto &rle = RleImages[i];
+    std::vector<uint8_t> corrupt(row_lz.compressed_data,
+                                 row_lz.compressed_data +
+                                     row_lz.compressed_size);
+    corrupt[corrupt.size() / 2] ^= 0x5a;
+    auto bad = row_lz;
+    bad.compressed_data = corrupt.data();
+    RowLzDecoder row_lz_decoder;
+    RleDecoder rle_decoder;
+    if (decode_frame(bad, decoded.data()) ||
+        row_lz_decoder.decode(row_lz.compressed_data,
+                              row_lz.band_offsets[1] / 2,
+                              band_rows(row_lz, 0), decoded.data()) ||
+        rle_decoder.decode(rle.compressed_data, rle.band_offsets[1] / 2,
+                           band_rows(rle, 0), decoded.data())) {
+      std::printf("%s: corrupt stream went unnoticed\n", zlib.name);
+      ok = false;
+    }
+
+    // A corrupt blob must fail its CRC before it's shown, and a zlib one
+    // streamed regardless must fail its Adler-32.
+    corrupt.assign(zlib.compressed_data,
+                   zlib.compressed_data + zlib.compressed_size);
+    corrupt[corrupt.size() / 3] ^= 0x01;
+    bad = zlib;
+    bad.compressed_data = corrupt.data();
+    RecordingTransport panel;
+    static StreamDecoder streamer;
+    if (!image_intact(zlib) || !image_intact(row_lz) ||
+        image_intact(bad) ||
+        (bad.codec == Codec::Zlib && streamer.decode(bad, panel) >= 0)) {
+      std::printf("%s: CRC or Adler-32 check failed\n", zlib.name);
+      ok = false;
+    }
+  }
+  // Two bands each a row off, one long and one short, still add up to a
+  // frame; the streamed decode must catch the first rather than the total.
+  {
+    constexpr size_t band_rows = frame::Height / 2;
+    std::vector<uint8_t> data;
+    append_stored(data, (band_rows + 1) * frame::RowBytes);
+    const auto split = static_cast<uint32_t>(data.size());
+    append_stored(data, (band_rows - 1) * frame::RowBytes);
+    const uint32_t offsets[] = {0, split, static_cast<uint32_t>(data.size())};
+    Image skewed{};
+    skewed.name = "skewed bands";
+    skewed.compressed_data = data.data();
+    skewed.compressed_size = data.size();
+    skewed.format = PixelFormat::Nibble4;
+    skewed.codec = Codec::Deflate;
+    skewed.band_rows = band_rows;
+    skewed.num_bands = 2;
+    skewed.band_offsets = offsets;
+    RecordingTransport panel;
+    static StreamDecoder streamer;
+    const auto sent = streamer.decode(skewed, panel);
+    if (sent >= 0 || decode_frame(skewed, decoded.data())) {
+      std::printf("%s: streamed %d bytes unnoticed\n", skewed.name,
+                  static_cast<int>(sent));
+      ok = false;
+    }
+  }
+  for (const auto &table : tables)
+    std::printf("%-36s %-8s %7zu\n", "total", table.name, table.total);
+  std::printf("decoder state: inflate %zu bytes, row LZ %zu bytes, RLE %zu "
+              "bytes\n",
+              sizeof(Inflater), sizeof(RowLzDecoder), sizeof(RleDecoder));
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,121 @@
+// Checks the word stream pio_stream encodes for the eink_spi PIO program:
+// the header words, bytes packed MSB first with the last word zero padded,
+// command tables encoded back to back, and data longer than one frame split
+// at MaxFrameBytes.
+//   pio_stream_test
+#include "pio_stream.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+bool ok = true;
+
+void expect(bool passed, const char *what) {
+  if (!passed) {
+    std::printf("FAILED: %s\n", what);
+    ok = false;
+  }
+}
+
+// The bit count a header asks the PIO program to shift out.
+uint32_t header_bits(uint32_t header) {
+  return header & pio_stream::BitCountMask;
+}
+
+} // namespace
+
+int main() {
+  using namespace pio_stream;
+
+  // Headers: the flag and command byte at the top, then the bits to send.
+  expect(command_header(0x12, 0) == 0x89000000, "command header, no params");
+  expect(command_header(0x61, 4) == (CommandFlag | 0x61u << 23 | 32),
+         "command header with params");
+  expect(command_header(0xff, 255) == (CommandFlag | 0xffu << 23 | 255 * 8),
+         "largest command header");
+  expect(data_header(3) == 24, "data header");
+  expect(!(data_header(MaxFrameBytes) & CommandFlag) &&
+             header_bits(data_header(MaxFrameBytes)) == MaxFrameBytes * 8,
+         "largest data frame fits its header");
+  expect(fill_word(0x5a) == 0x5a5a5a5a, "fill word");
+
+  // Packing: first byte in the MSB, the tail zero padded.
+  const uint8_t bytes[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+  uint32_t packed[3] = {~0u, ~0u, ~0u};
+  expect(pack(bytes, 6, packed) == 2, "pack word count");
+  expect(packed[0] == 0x01020304, "pack MSB first");
+  expect(packed[1] == 0x05060000, "pack pads the tail with zeros");
+  expect(packed[2] == ~0u, "pack writes no further");
+  expect(pack(bytes, 0, packed) == 0, "pack nothing");
+  for (size_t length = 1; length <= 4; ++length) {
+    pack(bytes, length, packed);
+    const uint32_t expected[] = {0x01000000, 0x01020000, 0x01020300,
+                                 0x01020304};
+    expect(packed[0] == expected[length - 1], "pack a partial word");
+  }
+
+  // A command frame: header, then its parameters packed.
+  uint32_t command[4] = {};
+  expect(encode_command(0x61, bytes, 5, command) == 3, "command word count");
+  expect(command[0] == command_header(0x61, 5) && command[1] == 0x01020304 &&
+             command[2] == 0x05000000,
+         "command frame");
+  expect(encode_command(0x12, nullptr, 0, command) == 1 &&
+             command[0] == command_header(0x12, 0),
+         "command without params");
+
+  // A command table is each of its commands' frames back to back.
+  const uint8_t table[] = {0x01, 2, 0xaa, 0xbb, 0x12, 0, 0x61, 5,
+                           1,    2, 3,    4,    5};
+  std::vector<uint32_t> commands(encoded_commands_size(table, sizeof(table)));
+  expect(commands.size() == 2 + 1 + 3, "command table size");
+  expect(encode_commands(table, sizeof(table), commands.data()) ==
+             commands.size(),
+         "command table word count");
+  expect(commands == std::vector<uint32_t>{command_header(0x01, 2), 0xaabb0000,
+                                           command_header(0x12, 0),
+                                           command_header(0x61, 5), 0x01020304,
+                                           0x05000000},
+         "command table frames");
+
+  // Data: one frame up to MaxFrameBytes, then split, each frame's last word
+  // padded on its own.
+  uint32_t small[3] = {};
+  expect(encode_data(bytes, 6, small) == 3 && small[0] == data_header(6) &&
+             small[1] == 0x01020304 && small[2] == 0x05060000,
+         "data frame");
+  expect(frame_bytes(MaxFrameBytes + 1) == MaxFrameBytes &&
+             frame_bytes(10) == 10,
+         "frame bytes");
+  const size_t length = MaxFrameBytes + 6;
+  std::vector<uint8_t> data(length);
+  for (size_t i = 0; i < length; ++i)
+    data[i] = static_cast<uint8_t>(i * 7 + 1);
+  std::vector<uint32_t> frames(encoded_data_size(length));
+  const auto first_words = 1 + words_for(MaxFrameBytes);
+  expect(frames.size() == first_words + 1 + 2, "split data size");
+  expect(encode_data(data.data(), length, frames.data()) == frames.size(),
+         "split data word count");
+  expect(frames[0] == data_header(MaxFrameBytes), "first frame header");
+  // MaxFrameBytes isn't a whole number of words, so its last is padded.
+  const auto last = MaxFrameBytes - (MaxFrameBytes - 1) % 4 - 1;
+  uint32_t tail[1];
+  pack(data.data() + last, MaxFrameBytes - last, tail);
+  expect(frames[first_words - 1] == tail[0] &&
+             (tail[0] & 0xff) == 0 &&
+             frames[1] == (uint32_t{data[0]} << 24 | data[1] << 16 |
+                           data[2] << 8 | data[3]),
+         "first frame payload");
+  expect(frames[first_words] == data_header(6), "second frame header");
+  uint32_t rest[2];
+  pack(data.data() + MaxFrameBytes, 6, rest);
+  expect(frames[first_words + 1] == rest[0] &&
+             frames[first_words + 2] == rest[1],
+         "second frame payload");
+
+  std::printf(ok ? "pio_stream: all checks passed\n" : "pio_stream: FAILED\n");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,63 @@
+// Runs the two-core decode pipeline on two threads over every embedded
+// image, many times over, checking the output against a whole-frame decode
+// and reporting throughput.
+#include "decode.hpp"
+#include "frame.hpp"
+#include "images.hpp"
+#include "pipeline.hpp"
+#include "recording_transport.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+  const int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+  if (rounds < 1) {
+    std::printf("rounds must be at least 1\n");
+    return EXIT_FAILURE;
+  }
+  auto pipeline = std::make_unique<DecodePipeline>();
+  RecordingTransport panel;
+  bool ok = true;
+
+  for (const auto &image : Image::Images) {
+    std::vector<uint8_t> expected(frame::Bytes);
+    if (!decode_frame(image, expected.data())) {
+      std::printf("%s: whole-frame decode failed\n", image.name);
+      ok = false;
+      continue;
+    }
+
+    std::chrono::steady_clock::duration elapsed{};
+    for (int round = 0; round < rounds; ++round) {
+      panel.reset();
+      auto start = std::chrono::steady_clock::now();
+      std::thread producer([&] { pipeline->produce(image); });
+      panel.open_data();
+      auto status = pipeline->drain(panel);
+      panel.close_data();
+      producer.join();
+      elapsed += std::chrono::steady_clock::now() - start;
+
+      const auto &sent = panel.transactions();
+      if (status != static_cast<int32_t>(expected.size()) ||
+          sent.size() != 1 || sent[0].data != expected) {
+        std::printf("%s: round %d: output mismatch (status %d)\n", image.name,
+                    round, status);
+        ok = false;
+        break;
+      }
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+                  .count() /
+              rounds;
+    std::printf("%-40s %8lld us/frame  %6.1f MB/s\n", image.name,
+                static_cast<long long>(us),
+                us ? static_cast<double>(expected.size()) / us : 0.0);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,108 @@
+// Checks the playlist over the embedded images: that Feistel is a
+// permutation at every size a playlist uses, that each pass shows every
+// image as many times as its weight, falling back to the other orientation
+// when one has no images, and that a position saved through PositionLog
+// resumes the same order. Also times picking an image.
+//   playlist_bench [rounds]
+#include "images.hpp"
+#include "playlist.hpp"
+#include "position_log.hpp"
+#include "ram_flash.hpp"
+#include "state_log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+namespace {
+
+// The next `count` images `portrait` way up.
+std::vector<size_t> picks(Playlist &playlist, bool portrait, size_t count) {
+  std::vector<size_t> image_ids;
+  for (size_t i = 0; i < count; ++i)
+    image_ids.push_back(playlist.next(portrait));
+  return image_ids;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const int rounds = argc > 1 ? std::atoi(argv[1]) : 1000;
+  bool ok = true;
+
+  for (uint32_t size = 1; size <= 1024; ++size) {
+    for (uint32_t key : {0u, 1u, 0xdeadbeefu}) {
+      const Feistel order(size, key);
+      std::vector<bool> seen(size);
+      for (uint32_t index = 0; index < size; ++index) {
+        const auto to = order(index);
+        if (to >= size || seen[to]) {
+          std::printf("Feistel(%u, %08x) isn't a permutation\n", size, key);
+          ok = false;
+          break;
+        }
+        seen[to] = true;
+      }
+    }
+  }
+
+  const auto images = image_list();
+  for (const bool portrait : {false, true}) {
+    const bool way = images.count[portrait] ? portrait : !portrait;
+    size_t per_pass = 0;
+    for (size_t i = 0; i < images.count[way]; ++i)
+      per_pass += std::min<uint32_t>(
+          images[images.by_orientation[way][i]].weight, Playlist::MaxWeight);
+    Playlist playlist(0x1234);
+    for (int pass = 0; pass < 3; ++pass) {
+      std::map<size_t, uint32_t> shown;
+      for (const auto image_id : picks(playlist, portrait, per_pass))
+        ++shown[image_id];
+      for (size_t i = 0; i < images.count[way]; ++i) {
+        const auto image_id = images.by_orientation[way][i];
+        const auto weight =
+            std::min<uint32_t>(images[image_id].weight, Playlist::MaxWeight);
+        if (shown[image_id] != weight) {
+          std::printf("pass %d %s: %s shown %u times, not %u\n", pass,
+                      portrait ? "portrait" : "landscape",
+                      images[image_id].name, shown[image_id], weight);
+          ok = false;
+        }
+      }
+    }
+  }
+
+  // A restored position carries on the same order, from a log that's moved
+  // through its sectors a few times.
+  RamFlash flash(4 * FlashArea::SectorBytes);
+  Playlist playlist(42);
+  for (int save = 0; save < 1000; ++save) {
+    playlist.next(false);
+    StateLog state(flash);
+    PositionLog(state).save(playlist.position());
+    state.flush();
+  }
+  const auto expected = picks(playlist, false, 20);
+  Playlist resumed(7);
+  Playlist::Position position{};
+  StateLog state(flash);
+  if (!PositionLog(state).load(position) ||
+      (resumed.resume(position), picks(resumed, false, 20)) != expected) {
+    std::printf("resuming from flash went wrong\n");
+    ok = false;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round)
+    playlist.next(round & 1);
+  std::printf("%zu images: %lld ns to pick one\n", images.size,
+              static_cast<long long>(
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count() /
+                  rounds));
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
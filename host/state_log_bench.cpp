@@ -0,0 +1,111 @@
+// Checks the state log against RamFlash: that sets between flushes are
+// coalesced, that wear spreads over every sector, and, by cutting the power
+// at random points through random flushes, that a reset only ever loses
+// the flush it interrupted.
+//   state_log_bench [trials]
+#include "ram_flash.hpp"
+#include "state_log.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Values = std::map<uint16_t, std::vector<uint8_t>>;
+
+bool holds(const StateLog &state, uint16_t key,
+           const std::vector<uint8_t> &value) {
+  std::vector<uint8_t> read(value.size());
+  return state.get(key, read.data(), read.size()) && read == value;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const int trials = argc > 1 ? std::atoi(argv[1]) : 200;
+  bool ok = true;
+
+  // A position saved every five minutes for a week, into the 64KB the
+  // device uses, along with the rarely changing counters.
+  {
+    RamFlash flash(16 * FlashArea::SectorBytes);
+    StateLog state(flash);
+    constexpr uint32_t Saves = 7 * 24 * 12;
+    for (uint32_t save = 0; save < Saves; ++save) {
+      const uint32_t position[4] = {save, save / 3, save / 7, 0};
+      // Set more often than flushed; only the last counts.
+      for (uint32_t i = 0; i < 3; ++i)
+        state.set(1, position);
+      if (save % 12 == 0)
+        state.set(2, save / 12);
+      state.flush();
+    }
+    uint32_t position[4];
+    if (!StateLog(flash).get(1, position) || position[0] != Saves - 1) {
+      std::printf("the last position wasn't read back\n");
+      ok = false;
+    }
+    std::printf("%u flushes: %zu erases, one every %zu flushes\n", Saves,
+                flash.erases(), Saves / flash.erases());
+  }
+
+  // Random flushes of random values, with the power cut part way through
+  // some of them.
+  size_t cuts = 0;
+  for (int trial = 0; trial < trials; ++trial) {
+    std::mt19937 random(trial);
+    RamFlash flash(2 * FlashArea::SectorBytes);
+    auto state = std::make_unique<StateLog>(flash);
+    Values saved;
+    flash.cut_power_after(random() % (3 * FlashArea::SectorBytes));
+    for (int flush = 0; flush < 200; ++flush) {
+      auto next = saved;
+      for (auto sets = random() % 4; sets > 0; --sets) {
+        const auto key = static_cast<uint16_t>(1 + random() % 6);
+        std::vector<uint8_t> value(1 + random() % StateLog::MaxValueBytes);
+        for (auto &byte : value)
+          byte = static_cast<uint8_t>(random());
+        state->set(key, value.data(), value.size());
+        next[key] = value;
+      }
+      state->flush();
+      if (flash.powered()) {
+        saved = next;
+        continue;
+      }
+
+      // Each value must be what it was before the flush or after it, or
+      // still unset if it was before.
+      ++cuts;
+      flash.restore_power();
+      state = std::make_unique<StateLog>(flash);
+      for (const auto &[key, value] : next) {
+        const auto before = saved.find(key);
+        if (holds(*state, key, value)) {
+          saved[key] = value;
+        } else if (before != saved.end() &&
+                   !holds(*state, key, before->second)) {
+          std::printf("trial %d flush %d: key %u lost\n", trial, flush, key);
+          ok = false;
+          saved.erase(key);
+        }
+      }
+      flash.cut_power_after(random() % (3 * FlashArea::SectorBytes));
+    }
+    flash.restore_power();
+    StateLog rebooted(flash);
+    for (const auto &[key, value] : saved) {
+      if (!holds(rebooted, key, value)) {
+        std::printf("trial %d: key %u wrong after a clean reboot\n", trial,
+                    key);
+        ok = false;
+      }
+    }
+  }
+  std::printf("%d trials: %zu power cuts survived\n", trials, cuts);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
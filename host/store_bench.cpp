@@ -0,0 +1,173 @@
+// Loads the flash image store py/pack_store.py writes and decodes every
+// image in it, checking each against the zlib build of the same image and
+// timing the load. Also checks that a corrupt index, band tables and
+// palettes included, refuses the store, as do band tables and palettes that
+// pass the CRC but can't be right, that corrupt image data fails its CRC,
+// and that the orientation indexes the store and the generator build agree
+// with the images.
+//   store_bench [rounds] [image_store.bin]
+#include "crc.hpp"
+#include "decode.hpp"
+#include "frame.hpp"
+#include "image_store.hpp"
+#include "images.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+extern const Image ZlibImages[Image::NumImages];
+
+namespace {
+
+template <typename Run> long long time_ns(int rounds, Run run) {
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round)
+    run();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         rounds;
+}
+
+const Image *zlib_image(const char *name) {
+  for (const auto &image : ZlibImages)
+    if (!std::strcmp(image.name, name))
+      return &image;
+  return nullptr;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+  const char *path = argc > 2 ? argv[2] : FRAME_IMAGE_STORE_BIN;
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> store{std::istreambuf_iterator<char>(file), {}};
+  // ImageStore wants it word aligned, as it is in flash.
+  std::vector<uint32_t> words((store.size() + 3) / 4);
+  std::memcpy(words.data(), store.data(), store.size());
+  const auto *base = reinterpret_cast<const uint8_t *>(words.data());
+
+  static ImageStore images;
+  if (!images.load(base, store.size())) {
+    std::printf("%s: not a valid image store\n", path);
+    return EXIT_FAILURE;
+  }
+  std::printf("%s: %zu images in %zu bytes, loaded in %lld ns\n", path,
+              images.size(), store.size(),
+              time_ns(rounds, [&] { images.load(base, store.size()); }));
+
+  bool ok = true;
+  std::vector<uint8_t> expected(frame::Bytes);
+  std::vector<uint8_t> decoded(frame::Bytes);
+  for (size_t i = 0; i < images.size(); ++i) {
+    const auto &image = images.images()[i];
+    const auto *zlib = zlib_image(image.name);
+    if (!zlib || !decode_frame(*zlib, expected.data())) {
+      std::printf("%s: no zlib build to check it against\n", image.name);
+      ok = false;
+      continue;
+    }
+    if (!image_intact(image) || !decode_frame(image, decoded.data()) ||
+        expected != decoded) {
+      std::printf("%s: doesn't decode to match zlib\n", image.name);
+      ok = false;
+      continue;
+    }
+    std::printf("%-36s %7zu bytes, decoded in %lld us\n", image.name,
+                image.compressed_size,
+                time_ns(rounds,
+                        [&] { decode_frame(image, decoded.data()); }) /
+                    1000);
+
+    // Corrupt data is left for image_intact() to catch.
+    const auto offset = image.compressed_data - base;
+    words[(offset + image.compressed_size / 2) / 4] ^= 0x100;
+    if (image_intact(image)) {
+      std::printf("%s: corrupt data passed its CRC\n", image.name);
+      ok = false;
+    }
+    words[(offset + image.compressed_size / 2) / 4] ^= 0x100;
+  }
+
+  // Each orientation's index lists its images in order, as does the
+  // generator's.
+  for (const auto &list : {images.list(), image_list()}) {
+    for (const bool portrait : {false, true}) {
+      std::vector<size_t> expected_ids;
+      for (size_t i = 0; i < list.size; ++i)
+        if (list[i].portrait == portrait)
+          expected_ids.push_back(i);
+      if (!std::equal(expected_ids.begin(), expected_ids.end(),
+                      list.by_orientation[portrait],
+                      list.by_orientation[portrait] + list.count[portrait])) {
+        std::printf("the %s index is wrong\n",
+                    portrait ? "portrait" : "landscape");
+        ok = false;
+      }
+    }
+  }
+  // Any change to the index, a name, band table or palette included,
+  // refuses the whole store.
+  const auto &first = images.images()[0];
+  std::vector<size_t> index_bytes = {
+      0, 12, sizeof(store::Header) + 4,
+      static_cast<size_t>(reinterpret_cast<const uint8_t *>(
+                              first.band_offsets + 1) -
+                          base)};
+  const Image *remapped = nullptr;
+  for (size_t i = 0; i < images.size(); ++i)
+    if (images.images()[i].palette)
+      remapped = &images.images()[i];
+  if (remapped)
+    index_bytes.push_back(remapped->palette - base);
+  for (size_t at : index_bytes) {
+    words[at / 4] ^= 0x10000;
+    ImageStore corrupt;
+    if (corrupt.load(base, store.size()) || corrupt.size()) {
+      std::printf("corrupting byte %zu went unnoticed\n", at / 4 * 4 + 2);
+      ok = false;
+    }
+    words[at / 4] ^= 0x10000;
+  }
+
+  // Band tables out of order or not ending at the data's end, and palettes
+  // holding more than colours, are refused even with the CRC made good.
+  const auto refused = [&](size_t word, uint32_t value, const char *what) {
+    const auto original = words[word];
+    const auto original_crc = words[1];
+    words[word] = value;
+    const auto version = offsetof(store::Header, version);
+    store::Header header;
+    std::memcpy(&header, base, sizeof(header));
+    words[1] = blob_crc32(base + version, header.index_size - version);
+    ImageStore forged;
+    if (forged.load(base, store.size())) {
+      std::printf("%s went unnoticed\n", what);
+      ok = false;
+    }
+    words[word] = original;
+    words[1] = original_crc;
+  };
+  const auto bands = static_cast<size_t>(
+      reinterpret_cast<const uint8_t *>(first.band_offsets) - base) / 4;
+  if (first.num_bands > 1)
+    refused(bands + 1, first.band_offsets[2] + 1, "a band out of order");
+  refused(bands + first.num_bands, first.band_offsets[first.num_bands] - 1,
+          "a band table short of the data");
+  if (remapped)
+    refused((remapped->palette - base) / 4, 0x08080808,
+            "a palette colour out of range");
+  ImageStore truncated;
+  if (truncated.load(base, store.size() - 1)) {
+    std::printf("a truncated store went unnoticed\n");
+    ok = false;
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
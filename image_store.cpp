@@ -0,0 +1,155 @@
+#include "image_store.hpp"
+
+#include "crc.hpp"
+#include "debug.hpp"
+
+#include <cstring>
+
+#if defined(FRAME_IMAGE_STORE) && defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "hardware/regs/addressmap.h"
+
+// The end of the firmware in flash, from the SDK's linker script.
+extern "C" char __flash_binary_end;
+#endif
+
+using namespace store;
+
+namespace {
+
+// Whether `length` bytes at `offset` lie within the first `size`.
+bool within(uint32_t offset, size_t length, size_t size) {
+  return offset <= size && length <= size - offset;
+}
+
+// tinfl's window, the most a dictionary can prime.
+constexpr size_t MaxDictionary = 32768;
+
+// Whether an entry's band table, at `bands` and already bounds checked,
+// splits exactly its data, in order.
+bool bands_valid(const uint32_t *bands, const Entry &entry) {
+  if (bands[0] != 0 || bands[entry.num_bands] != entry.data_size)
+    return false;
+  for (size_t band = 0; band < entry.num_bands; ++band)
+    if (bands[band] > bands[band + 1])
+      return false;
+  return true;
+}
+
+// Whether a palette, already bounds checked, holds only colours.
+bool palette_valid(const uint8_t *palette) {
+  for (size_t i = 0; i < PaletteBytes; ++i)
+    if (palette[i] >= NumColours)
+      return false;
+  return true;
+}
+
+} // namespace
+
+bool ImageStore::load(const uint8_t *base, size_t size) {
+  num_images_ = 0;
+  num_landscape_ = 0;
+  Header header;
+  if (size < sizeof(header))
+    return false;
+  std::memcpy(&header, base, sizeof(header));
+  const auto entries_end =
+      sizeof(header) + header.num_images * sizeof(Entry);
+  // The CRC covers the band tables and palettes too, so they're checked
+  // before anything is read from them.
+  const size_t index_size = header.index_size;
+  if (header.magic != Magic || header.version != Version ||
+      header.num_images > MaxImages || header.total_size > size ||
+      index_size > header.total_size || index_size < entries_end ||
+      blob_crc32(base + offsetof(Header, version),
+                 index_size - offsetof(Header, version)) != header.index_crc)
+    return false;
+  size = header.total_size;
+
+  const uint8_t *dictionary = nullptr;
+  if (header.dictionary_size) {
+    if (header.dictionary_size > MaxDictionary ||
+        !within(header.dictionary_offset, header.dictionary_size, size))
+      return false;
+    dictionary = base + header.dictionary_offset;
+    if (blob_crc32(dictionary, header.dictionary_size) !=
+        header.dictionary_crc)
+      return false;
+  }
+
+  for (size_t i = 0; i < header.num_images; ++i) {
+    const auto *at = base + sizeof(header) + i * sizeof(Entry);
+    Entry entry;
+    std::memcpy(&entry, at, sizeof(entry));
+    if (entry.name[NameBytes - 1] ||
+        !within(entry.data_offset, entry.data_size, size) ||
+        entry.bands_offset % 4 ||
+        !within(entry.bands_offset, (entry.num_bands + 1u) * 4, index_size) ||
+        !bands_valid(reinterpret_cast<const uint32_t *>(
+                         base + entry.bands_offset),
+                     entry) ||
+        (entry.palette_offset &&
+         (!within(entry.palette_offset, PaletteBytes, index_size) ||
+          !palette_valid(base + entry.palette_offset))) ||
+        entry.format > static_cast<uint8_t>(PixelFormat::Packed3) ||
+        entry.codec >= NumCodecs || (entry.uses_dictionary && !dictionary))
+      return false;
+    images_[i] = Image{
+        reinterpret_cast<const char *>(at + offsetof(Entry, name)),
+        base + entry.data_offset,
+        entry.data_size,
+        entry.crc,
+        entry.portrait != 0,
+        static_cast<PixelFormat>(entry.format),
+        static_cast<Codec>(entry.codec),
+        entry.band_rows,
+        entry.num_bands,
+        reinterpret_cast<const uint32_t *>(base + entry.bands_offset),
+        entry.uses_dictionary ? dictionary : nullptr,
+        static_cast<uint16_t>(entry.uses_dictionary ? header.dictionary_size
+                                                    : 0),
+        entry.filters,
+        entry.palette_offset ? base + entry.palette_offset : nullptr,
+        entry.weight};
+  }
+  num_images_ = header.num_images;
+  auto next = by_orientation_.begin();
+  for (bool portrait : {false, true}) {
+    for (size_t i = 0; i < num_images_; ++i)
+      if (images_[i].portrait == portrait)
+        *next++ = static_cast<uint16_t>(i);
+    if (!portrait)
+      num_landscape_ = next - by_orientation_.begin();
+  }
+  return true;
+}
+
+ImageList ImageStore::list() const {
+  return {images_.data(),
+          num_images_,
+          {by_orientation_.data(), by_orientation_.data() + num_landscape_},
+          {num_landscape_, num_images_ - num_landscape_}};
+}
+
+ImageList image_list() {
+#if defined(FRAME_IMAGE_STORE) && defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+  static ImageStore images;
+  [[maybe_unused]] static const bool loaded = [] {
+    const auto *base = reinterpret_cast<const uint8_t *>(XIP_BASE + Offset);
+    // A firmware grown into the region would read itself as the store.
+    if (reinterpret_cast<const uint8_t *>(&__flash_binary_end) > base) {
+      debug("image store: the firmware overlaps it");
+      return false;
+    }
+    const bool ok = images.load(base, Size);
+    debug("image store: %s, %zu images", ok ? "loaded" : "invalid",
+          images.size());
+    return ok;
+  }();
+  return images.list();
+#else
+  return {Image::Images,
+          Image::NumImages,
+          {Image::Landscape.data(), Image::Portrait.data()},
+          {Image::NumLandscape, Image::NumPortrait}};
+#endif
+}
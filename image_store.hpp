@@ -0,0 +1,110 @@
+#pragma once
+
+#include "images.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Images kept in a flash region of their own rather than compiled in, so
+// changing the photos means flashing just that region: py/pack_store.py
+// writes it as a UF2 that covers nothing else. The region is the index (a
+// Header, an Entry per image, then every image's band table and palette),
+// then the dictionary and each image's data, all little-endian and word
+// aligned. Images are read in place through XIP.
+namespace store {
+
+// py/pack_store.py reads the constants below from this file, so each stays
+// a `constexpr <type> <Name> = <literal>;` line.
+
+// Where the region sits in flash, clear of the firmware below it and the
+// last 64KB above.
+constexpr uint32_t Offset = 0x100000;
+constexpr uint32_t Size = 0xf0000;
+
+constexpr uint32_t Magic = 0x474d4946; // "FIMG"
+constexpr uint16_t Version = 3;
+constexpr size_t NameBytes = 48;
+// Palettes are padded to what filter::Remap may index, and hold colours.
+constexpr size_t PaletteBytes = 8;
+constexpr uint8_t NumColours = 8;
+
+struct Header {
+  uint32_t magic;
+  // CRC-32 of the rest of the index, which is all that's checked when the
+  // store is loaded; each image's data has its own CRC, checked before it's
+  // shown.
+  uint32_t index_crc;
+  uint16_t version;
+  uint16_t num_images;
+  uint32_t index_size; // of the header, entries, band tables and palettes
+  uint32_t total_size; // of the index, dictionary and data
+  // The preset dictionary images with Entry::uses_dictionary share.
+  uint32_t dictionary_offset;
+  uint32_t dictionary_size; // 0 for none
+  uint32_t dictionary_crc;
+};
+
+// Offsets are from the start of the region.
+struct Entry {
+  char name[NameBytes]; // NUL-terminated
+  uint32_t data_offset;
+  uint32_t data_size;
+  uint32_t crc; // of the data
+  uint32_t bands_offset;   // num_bands + 1 band offsets
+  uint32_t palette_offset; // 0 for none
+  uint16_t band_rows;
+  uint16_t num_bands;
+  uint8_t portrait;
+  uint8_t format; // PixelFormat
+  uint8_t codec;  // Codec
+  uint8_t filters;
+  uint8_t uses_dictionary;
+  uint8_t weight; // see Image::weight
+  uint8_t reserved[2];
+};
+
+static_assert(sizeof(Header) == 32 && sizeof(Entry) == 80,
+              "py/pack_store.py packs these without padding");
+
+} // namespace store
+
+// The images the frame shows.
+struct ImageList {
+  const Image *images;
+  size_t size;
+  // Indexes into `images` of the landscape and of the portrait ones (by
+  // `portrait`), each in order, and how many of each.
+  const uint16_t *by_orientation[2];
+  size_t count[2];
+
+  const Image &operator[](size_t index) const { return images[index]; }
+};
+
+// The images in a store, as Image structs pointing into it.
+class ImageStore {
+public:
+  // py/pack_store.py reads this too.
+  static constexpr size_t MaxImages = 64;
+
+  // Reads the index of the store in the `size` bytes at `base`, which must
+  // be word aligned. Returns false, and holds no images, if it isn't a
+  // valid store.
+  bool load(const uint8_t *base, size_t size);
+
+  [[nodiscard]] const Image *images() const { return images_.data(); }
+  [[nodiscard]] size_t size() const { return num_images_; }
+  [[nodiscard]] ImageList list() const;
+
+private:
+  std::array<Image, MaxImages> images_{};
+  size_t num_images_ = 0;
+  // The landscape indexes then the portrait ones, as the generator's
+  // Image::Landscape and Image::Portrait.
+  std::array<uint16_t, MaxImages> by_orientation_{};
+  size_t num_landscape_ = 0;
+};
+
+// Image::Images, or with FRAME_IMAGE_STORE the flash store's images, loaded
+// the first time they're asked for.
+ImageList image_list();
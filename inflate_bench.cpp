@@ -0,0 +1,459 @@
+// Inflates every band of the embedded images, as compressed with zlib, with
+// miniz's tinfl, both as zlib streams and as raw deflate without the header
+// and Adler-32, checks they agree, and reports how long each took, and how
+// long the blob CRC that raw deflate relies on takes. Checks raw deflate
+// against a full 32KB preset dictionary decodes to the same frames too.
+// Then fits py/conv.py's DECODE_CYCLES to each codec's band decode times.
+// Then decodes each image whole as the firmware does, with its bands staged
+// by the XIP streaming engine and read in place through the XIP cache, and
+// reports the time and the cache's hit rate for each, and times the row LZ
+// build of each image against the zlib one, decoded whole. On the device the
+// times are clk_sys cycles (the M0+ has no cycle counter, so they're timer
+// microseconds scaled by the clock) and the results go out over USB; the
+// host build is for checking the decoders still agree.
+#include "crc.hpp"
+#include "decode.hpp"
+#include "frame.hpp"
+#include "rle.hpp"
+#include "row_lz.hpp"
+#include "stream_inflate.hpp"
+#include "transport.hpp"
+
+#include "miniz.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "pico/stdlib.h" // NOLINT(modernize-deprecated-headers)
+#else
+#include <chrono>
+#endif
+
+extern const Image ZlibImages[Image::NumImages];
+extern const Image RowLzImages[Image::NumImages];
+extern const Image DictionaryImages[Image::NumImages];
+extern const Image RleImages[Image::NumImages];
+
+namespace {
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+constexpr const char *Unit = "cycles";
+uint64_t now() { return time_us_64(); }
+uint64_t elapsed(uint64_t since) {
+  return (time_us_64() - since) * (clock_get_hz(clk_sys) / 1'000'000);
+}
+// Counts XIP cache hits and accesses from zero.
+void reset_cache_counters() {
+  xip_ctrl_hw->ctr_hit = 0;
+  xip_ctrl_hw->ctr_acc = 0;
+}
+double cache_hit_percent() {
+  const uint32_t accesses = xip_ctrl_hw->ctr_acc;
+  return accesses ? 100.0 * xip_ctrl_hw->ctr_hit / accesses : 0.0;
+}
+#else
+constexpr const char *Unit = "us";
+uint64_t now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+uint64_t elapsed(uint64_t since) { return now() - since; }
+void reset_cache_counters() {}
+double cache_hit_percent() { return 0.0; }
+#endif
+
+// Keeps a CRC of what it's sent rather than the data itself.
+class ChecksumTransport final : public Transport {
+public:
+  using Transport::command;
+  void command(uint8_t, const uint8_t *, size_t) override {}
+  void start_data(const uint8_t *data, size_t length) override {
+    crc_ = static_cast<uint32_t>(mz_crc32(crc_, data, length));
+    bytes_ += length;
+  }
+  void start_fill(uint8_t value, size_t length) override {
+    bytes_ += length;
+    for (; length; --length)
+      crc_ = static_cast<uint32_t>(mz_crc32(crc_, &value, 1));
+  }
+  [[nodiscard]] bool busy() const override { return false; }
+  void wait() override {}
+
+  void reset() {
+    crc_ = MZ_CRC32_INIT;
+    bytes_ = 0;
+  }
+  [[nodiscard]] uint32_t crc() const { return crc_; }
+  [[nodiscard]] size_t bytes() const { return bytes_; }
+
+private:
+  uint32_t crc_ = MZ_CRC32_INIT;
+  size_t bytes_ = 0;
+};
+
+int32_t inflate(StreamInflater &inflater, const Image &image,
+                const uint8_t *data, size_t size, Transport &out) {
+  if (image.codec == Codec::Deflate)
+    return inflater.inflate_raw(data, size, image.dictionary,
+                                image.dictionary_size, out);
+  return inflater.inflate(data, size, out);
+}
+
+// A zlib stream's two header bytes and Adler-32, which raw deflate drops.
+constexpr size_t ZlibHeader = 2;
+constexpr size_t ZlibTrailer = 4;
+
+struct Result {
+  int32_t size;
+  uint32_t crc;
+};
+
+// Inflates a band, adding the time taken to `time`. With `raw`, a zlib band
+// is inflated as raw deflate, skipping its header and Adler-32.
+Result timed(StreamInflater &inflater, const Image &image, const uint8_t *data,
+             size_t size, bool raw, ChecksumTransport &out, uint64_t &time) {
+  out.reset();
+  const auto start = now();
+  const auto sent =
+      raw && image.codec == Codec::Zlib
+          ? inflater.inflate_raw(data + ZlibHeader,
+                                 size - ZlibHeader - ZlibTrailer, nullptr, 0,
+                                 out)
+          : inflate(inflater, image, data, size, out);
+  time += elapsed(start);
+  return {sent, out.crc()};
+}
+
+// Fits a band's decode time to `per_byte` times the bytes it decodes to
+// plus `per_input` times its compressed size, by least squares, as
+// py/conv.py's DECODE_CYCLES models it.
+class CostFit {
+public:
+  void add(double decoded, double input, double time) {
+    xx_ += decoded * decoded;
+    xy_ += decoded * input;
+    yy_ += input * input;
+    xt_ += decoded * time;
+    yt_ += input * time;
+  }
+  [[nodiscard]] double per_byte() const {
+    return (xt_ * yy_ - yt_ * xy_) / determinant();
+  }
+  [[nodiscard]] double per_input() const {
+    return (yt_ * xx_ - xt_ * xy_) / determinant();
+  }
+
+private:
+  [[nodiscard]] double determinant() const { return xx_ * yy_ - xy_ * xy_; }
+
+  double xx_ = 0;
+  double xy_ = 0;
+  double yy_ = 0;
+  double xt_ = 0;
+  double yt_ = 0;
+};
+
+StreamInflater tinfl;
+StreamDecoder decoder;
+RowLzDecoder row_lz_decoder;
+RleDecoder rle_decoder;
+
+// Decodes `image` whole to `out`, as the firmware streams it to the panel,
+// with bands staged or not, adding the time taken to `time`.
+int32_t timed_decode(const Image &image, bool staged, ChecksumTransport &out,
+                     uint64_t &time) {
+  set_band_streaming(staged);
+  out.reset();
+  const auto start = now();
+  const auto sent = decoder.decode(image, out);
+  time += elapsed(start);
+  return sent;
+}
+
+} // namespace
+
+int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+  stdio_init_all();
+  // Give the host a moment to open the USB serial port.
+  sleep_ms(3000);
+  const int rounds = 3;
+#else
+  const int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+  if (rounds < 1) {
+    std::printf("rounds must be at least 1\n");
+    return EXIT_FAILURE;
+  }
+#endif
+  bool ok = true;
+  ChecksumTransport out;
+
+  std::printf("%-36s %8s %10s %10s %6s\n", "image", "bytes", "tinfl",
+              "tinfl raw", "raw");
+  for (const auto &image : ZlibImages) {
+    uint64_t tinfl_time = 0;
+    uint64_t tinfl_raw_time = 0;
+    int32_t total = 0;
+    for (size_t band = 0; band < image.num_bands; ++band) {
+      const auto *data = image.compressed_data + image.band_offsets[band];
+      const auto size = image.band_offsets[band + 1] - image.band_offsets[band];
+      Result results[2]{};
+      for (int round = 0; round < rounds; ++round) {
+        results[0] = timed(tinfl, image, data, size, false, out, tinfl_time);
+        results[1] =
+            timed(tinfl, image, data, size, true, out, tinfl_raw_time);
+      }
+      total += results[0].size;
+      for (const auto &result : results) {
+        if (results[0].size < 0 || result.size != results[0].size ||
+            result.crc != results[0].crc) {
+          std::printf("%s: band %zu: inflated to %" PRId32
+                      " bytes (crc %08" PRIx32 "), as zlib %" PRId32
+                      " (crc %08" PRIx32 ")\n",
+                      image.name, band, result.size, result.crc,
+                      results[0].size, results[0].crc);
+          ok = false;
+        }
+      }
+
+      // Corrupt and truncated streams must be caught, not read past.
+      std::vector<uint8_t> bad(data, data + size);
+      bad[size / 2] ^= 0x5a;
+      if (image.codec == Codec::Zlib &&
+          inflate(tinfl, image, bad.data(), bad.size(), out) >= 0) {
+        std::printf("%s: band %zu: corruption went unnoticed\n", image.name,
+                    band);
+        ok = false;
+      }
+      if (inflate(tinfl, image, data, size / 2, out) >= 0) {
+        std::printf("%s: band %zu: truncation went unnoticed\n", image.name,
+                    band);
+        ok = false;
+      }
+    }
+    std::printf("%-36s %8" PRId32 " %10" PRIu64 " %10" PRIu64
+                " %5.2fx %s\n",
+                image.name, total, tinfl_time / rounds,
+                tinfl_raw_time / rounds,
+                tinfl_raw_time
+                    ? static_cast<double>(tinfl_time) / tinfl_raw_time
+                    : 0.0,
+                Unit);
+
+    // Raw deflate relies on the blob's CRC instead, checked once per image
+    // rather than per band.
+    uint64_t software_time = 0;
+    uint64_t blob_time = 0;
+    uint32_t software = 0;
+    uint32_t blob = 0;
+    for (int round = 0; round < rounds; ++round) {
+      auto start = now();
+      software = static_cast<uint32_t>(mz_crc32(
+          MZ_CRC32_INIT, image.compressed_data, image.compressed_size));
+      software_time += elapsed(start);
+      start = now();
+      blob = blob_crc32(image.compressed_data, image.compressed_size);
+      blob_time += elapsed(start);
+    }
+    std::printf("%-36s CRC of %zu bytes: mz_crc32 %" PRIu64
+                ", blob_crc32 %" PRIu64 " %s\n",
+                "", image.compressed_size, software_time / rounds,
+                blob_time / rounds, Unit);
+    if (software != image.crc || blob != image.crc) {
+      std::printf("%s: CRC %08" PRIx32 " / %08" PRIx32 ", expected %08" PRIx32
+                  "\n",
+                  image.name, software, blob, image.crc);
+      ok = false;
+    }
+  }
+
+  // A truncated stored block must stop before sending what lies past the
+  // end of the input.
+  {
+    // A zlib header, one final stored block, then the Adler-32.
+    constexpr uint16_t length = 4 * StreamInflater::InputChunk;
+    std::vector<uint8_t> stored = {0x78, 0x01, 0x01, length & 0xff,
+                                   length >> 8, 0xff & ~length,
+                                   0xff & ~length >> 8};
+    for (uint32_t i = 0; i < length; ++i)
+      stored.push_back(static_cast<uint8_t>(i * 37));
+    const auto adler = static_cast<uint32_t>(
+        mz_adler32(MZ_ADLER32_INIT, stored.data() + 7, length));
+    for (int shift = 24; shift >= 0; shift -= 8)
+      stored.push_back(static_cast<uint8_t>(adler >> shift));
+
+    const auto half = stored.size() / 2;
+    const auto whole = tinfl.inflate(stored.data(), stored.size(), out);
+    out.reset();
+    const auto truncated = tinfl.inflate(stored.data(), half, out);
+    if (whole != length || truncated >= 0 || out.bytes() > half) {
+      std::printf("stored block: inflated to %" PRId32 ", truncated to %" PRId32
+                  ", sending %zu bytes from %zu\n",
+                  whole, truncated, out.bytes(), half);
+      ok = false;
+    }
+  }
+
+  // With a preset dictionary, matches reach back past the band's start into
+  // the end of the window, where tinfl's is primed. Each image must decode
+  // to the zlib build's frame; "primed" counts the bands that decode
+  // differently against a dictionary of zeros, so did reach back into it.
+  std::printf("\n%-36s %8s %10s %6s\n", "preset dictionary", "bytes",
+              "tinfl", "primed");
+  for (size_t i = 0; i < Image::NumImages; ++i) {
+    const auto &image = DictionaryImages[i];
+    if (image.codec != Codec::Deflate || !image.dictionary_size) {
+      std::printf("%s: no preset dictionary\n", image.name);
+      ok = false;
+      continue;
+    }
+    uint64_t time = 0;
+    int32_t total = 0;
+    size_t primed = 0;
+    const std::vector<uint8_t> zeros(image.dictionary_size);
+    for (size_t band = 0; band < image.num_bands; ++band) {
+      const auto *data = image.compressed_data + image.band_offsets[band];
+      const auto size = image.band_offsets[band + 1] - image.band_offsets[band];
+      Result result{};
+      for (int round = 0; round < rounds; ++round)
+        result = timed(tinfl, image, data, size, false, out, time);
+      total += result.size;
+      out.reset();
+      const auto sent =
+          tinfl.inflate_raw(data, size, zeros.data(), zeros.size(), out);
+      if (sent != result.size || out.crc() != result.crc)
+        ++primed;
+    }
+    uint64_t unused = 0;
+    const auto sizes = timed_decode(image, true, out, unused);
+    const auto crc = out.crc();
+    if (timed_decode(ZlibImages[i], true, out, unused) != sizes ||
+        out.crc() != crc || sizes != static_cast<int32_t>(frame::Bytes)) {
+      std::printf("%s: decodes differently against the dictionary\n",
+                  image.name);
+      ok = false;
+    }
+    std::printf("%-36s %8" PRId32 " %10" PRIu64 " %6zu %s\n", image.name,
+                total, time / rounds, primed, Unit);
+  }
+
+  // The compressed data goes through the XIP cache only when it's read in
+  // place, evicting the code that runs from flash on its way.
+  std::printf("\n%-36s %10s %6s %10s %6s\n", "decode", "staged", "hits",
+              "in place", "hits");
+  for (const auto &image : ZlibImages) {
+    uint64_t times[2] = {};
+    double hits[2] = {};
+    uint32_t crcs[2] = {};
+    int32_t sizes[2] = {};
+    for (int staged = 1; staged >= 0; --staged) {
+      reset_cache_counters();
+      for (int round = 0; round < rounds; ++round)
+        sizes[staged] = timed_decode(image, staged, out, times[staged]);
+      hits[staged] = cache_hit_percent();
+      crcs[staged] = out.crc();
+    }
+    std::printf("%-36s %10" PRIu64 " %5.1f%% %10" PRIu64 " %5.1f%% %s\n",
+                image.name, times[1] / rounds, hits[1], times[0] / rounds,
+                hits[0], Unit);
+    if (sizes[1] != static_cast<int32_t>(frame::Bytes) ||
+        sizes[0] != sizes[1] || crcs[0] != crcs[1]) {
+      std::printf("%s: staged and in-place decodes differ\n", image.name);
+      ok = false;
+    }
+  }
+  set_band_streaming(true);
+
+  // Row LZ exists to decode faster than inflate, so compare the two as the
+  // firmware decodes a frame, checking both send the panel the same.
+  std::printf("\n%-36s %10s %10s %6s\n", "whole image", "zlib", "row LZ",
+              "");
+  for (size_t i = 0; i < Image::NumImages; ++i) {
+    uint64_t times[2] = {};
+    uint32_t crcs[2] = {};
+    int32_t sizes[2] = {};
+    for (int round = 0; round < rounds; ++round) {
+      sizes[0] = timed_decode(ZlibImages[i], true, out, times[0]);
+      crcs[0] = out.crc();
+      sizes[1] = timed_decode(RowLzImages[i], true, out, times[1]);
+      crcs[1] = out.crc();
+    }
+    std::printf("%-36s %10" PRIu64 " %10" PRIu64 " %5.2fx %s\n",
+                ZlibImages[i].name, times[0] / rounds, times[1] / rounds,
+                times[1] ? static_cast<double>(times[0]) / times[1] : 0.0,
+                Unit);
+    if (sizes[0] != static_cast<int32_t>(frame::Bytes) ||
+        sizes[1] != sizes[0] || crcs[1] != crcs[0]) {
+      std::printf("%s: row LZ and zlib decodes differ\n", ZlibImages[i].name);
+      ok = false;
+    }
+  }
+
+  // The firmware's decoders on each band alone, filters and unpacking aside
+  // (conv.py costs those separately). The lines printed on the device at
+  // 125MHz are what DECODE_CYCLES should hold.
+  std::printf("\nDECODE_CYCLES, fitted over every band (%s per byte):\n",
+              Unit);
+  CostFit fits[4];
+  for (size_t i = 0; i < Image::NumImages; ++i) {
+    for (size_t band = 0; band < ZlibImages[i].num_bands; ++band) {
+      const auto &zlib = ZlibImages[i];
+      const auto *data = zlib.compressed_data + zlib.band_offsets[band];
+      const auto size = zlib.band_offsets[band + 1] - zlib.band_offsets[band];
+      uint64_t times[2] = {};
+      Result results[2]{};
+      for (int round = 0; round < rounds; ++round) {
+        results[0] = timed(tinfl, zlib, data, size, false, out, times[0]);
+        results[1] = timed(tinfl, zlib, data, size, true, out, times[1]);
+      }
+      fits[0].add(results[0].size, size,
+                  static_cast<double>(times[0]) / rounds);
+      fits[1].add(results[1].size, size - ZlibHeader - ZlibTrailer,
+                  static_cast<double>(times[1]) / rounds);
+    }
+    const Image *panel_images[] = {&RowLzImages[i], &RleImages[i]};
+    for (size_t codec = 0; codec < 2; ++codec) {
+      const auto &image = *panel_images[codec];
+      for (size_t band = 0; band < image.num_bands; ++band) {
+        const auto *data = image.compressed_data + image.band_offsets[band];
+        const auto size =
+            image.band_offsets[band + 1] - image.band_offsets[band];
+        const auto rows = band_rows(image, band);
+        uint64_t time = 0;
+        int32_t sent = 0;
+        for (int round = 0; round < rounds; ++round) {
+          out.reset();
+          const auto start = now();
+          sent = codec ? rle_decoder.decode(data, size, rows, out)
+                       : row_lz_decoder.decode(data, size, rows, out);
+          time += elapsed(start);
+        }
+        if (sent != static_cast<int32_t>(rows * frame::RowBytes)) {
+          std::printf("%s: band %zu doesn't decode\n", image.name, band);
+          ok = false;
+        }
+        fits[2 + codec].add(sent, size, static_cast<double>(time) / rounds);
+      }
+    }
+  }
+  const char *const codecs[] = {"zlib", "deflate", "rowlz", "rle"};
+  for (size_t codec = 0; codec < 4; ++codec)
+    std::printf("    '%s': (%.3g, %.3g),\n", codecs[codec],
+                fits[codec].per_byte(), fits[codec].per_input());
+
+  std::printf("decoder state: tinfl %zu bytes, row LZ %zu bytes\n",
+              sizeof(StreamInflater), sizeof(RowLzDecoder));
+  std::printf(ok ? "all bands agree\n" : "MISMATCHES\n");
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+  for (;;)
+    sleep_ms(1000);
+#else
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+#endif
+}
@@ -1,235 +1,219 @@
+#include "debug.hpp"
+#include "decode.hpp"
+#include "flash_area.hpp"
+#include "image_store.hpp"
 #include "images.hpp"
-#include "miniz.h"
+#include "pins.hpp"
+#include "pio_transport.hpp"
+#include "pipeline.hpp"
+#include "playlist.hpp"
+#include "position_log.hpp"
+#include "prefetch.hpp"
+#include "screen.hpp"
+#include "spi_transport.hpp"
+#include "state_log.hpp"
 
 #include "hardware/gpio.h"
-#include "hardware/spi.h"
+#include "hardware/structs/rosc.h"
 #include "hardware/sync.h"
 #include "pico/binary_info.h"
+#include "pico/multicore.h"
 #include "pico/stdlib.h" // NOLINT(modernize-deprecated-headers)
+#include <algorithm>
 #include <array>
-#include <cstdio>
-#include <utility>
+#include <malloc.h>
 
-struct Pins {
-  static constexpr auto Mosi = 19;
-  static constexpr auto ChipSel = 17;
-  static constexpr auto Clock = 18;
-  static constexpr auto Led = 25;
-  static constexpr auto Dc = 15;
-  static constexpr auto Reset = 14;
-  static constexpr auto Busy = 13;
-  static constexpr auto Orientation = 12;
-  static const inline auto SpiInst = spi0;
-};
 bi_decl(bi_4pins_with_names(Pins::ChipSel, "E-ink chip select", Pins::Dc,
                             "E-ink command", Pins::Reset, "E-ink reset",
                             Pins::Busy, "E-ink busy"));
 bi_decl(bi_1pin_with_name(Pins::Led, "On-board LED"));
 bi_decl(bi_3pins_with_func(Pins::Mosi, Pins::Clock, Pins::Dc, GPIO_FUNC_SPI));
 
-constexpr uint8_t low_byte(size_t value) { return value & 0xff; }
-constexpr uint8_t high_byte(size_t value) { return (value >> 8) & 0xff; }
-[[gnu::noinline]] static void delayNs(size_t nanos) {
-  static constexpr auto nsPerNop = 5; // 7.5ish at 133MHz, but...paranoia?
-  auto numNops = (nanos + nsPerNop - 1) / nsPerNop;
-  for (auto i = 0; i < numNops; ++i)
-    asm volatile("nop");
+volatile bool orientation_changed = false;
+
+void gpio_callback(uint gpio, uint32_t events) {
+  gpio_acknowledge_irq(gpio, events);
+  orientation_changed = true;
+  gpio_put(Pins::Led, true);
+  __sev();
 }
 
-template <typename... Args>
-void debug([[maybe_unused]] const char *format,
-           [[maybe_unused]] Args &&...args) {
-#ifndef NDEBUG
-  if constexpr (sizeof...(args) == 0) {
-    puts(format);
-  } else {
-    printf(format, std::forward<Args>(args)...);
-    puts("");
-  }
-#endif
+static int64_t sev_callback(alarm_id_t, void *) {
+  __sev();
+  return 0;
 }
 
-class Screen {
-  static inline void cs_select() {
-    delayNs(20);                    // hold time
-    gpio_put(Pins::ChipSel, false); // Active low
-    delayNs(60);                    // setup time
-  }
+// What's kept in the state log. A retired key's number isn't reused, as
+// flash may still hold its last value.
+namespace state_key {
+constexpr uint16_t Position = PositionLog::Key;
+constexpr uint16_t Counters = 2;
+constexpr uint16_t Errors = 3;
+} // namespace state_key
 
-  static inline void cs_deselect() {
-    delayNs(65); // hold time
-    gpio_put(Pins::ChipSel, true);
-    delayNs(40); // setup time
-  }
-  template <typename... Args> void send_command(uint8_t command, Args... data) {
-    gpio_put(Pins::Dc, false);
-    cs_select();
-    spi_write_blocking(Pins::SpiInst, &command, 1);
-    cs_deselect();
-    send_data(std::forward<Args>(data)...);
-  }
-  void send_data1(uint8_t data) {
-    gpio_put(Pins::Dc, true);
-    cs_select();
-    spi_write_blocking(Pins::SpiInst, &data, 1);
-    cs_deselect();
-  }
-  void send_data() {}
-  void send_data(const uint8_t *data, size_t length) {
-    gpio_put(Pins::Dc, true);
-    cs_select();
-    spi_write_blocking(Pins::SpiInst, data, length);
-    cs_deselect();
-  }
-  void send_repeated_data(uint8_t data, size_t length) {
-    gpio_put(Pins::Dc, true);
-    cs_select();
-    for (size_t i = 0; i < length; ++i)
-      spi_write_blocking(Pins::SpiInst, &data, 1);
-    cs_deselect();
-  }
-  template <typename... Args> void send_data(uint8_t first, Args... rest) {
-    send_data1(first);
-    int x[sizeof...(Args)] = {(send_data1(rest), 0)...};
-  }
-
-  void busy_high() const {
-    delayNs(60); // unlikely to be needed (seen blank screen issues)
-    while (!gpio_get(Pins::Busy))
-      /*spin*/;
-    delayNs(60); // unlikely to be needed (seen blank screen issues)
-  }
-  void busy_low() const {
-    delayNs(60); // unlikely to be needed (seen blank screen issues)
-    while (gpio_get(Pins::Busy))
-      /*spin*/;
-    delayNs(60); // unlikely to be needed (seen blank screen issues)
-  }
+// Running totals since the state log was first written.
+struct Counters {
+  uint32_t boots;
+  uint32_t refreshes;
+  uint32_t decode_failures;
+  uint32_t busy_timeouts;
+};
 
-public:
-  static constexpr auto Width = 600;
-  static constexpr auto Height = 448;
-  Screen() {
-    // Enable SPI at 1 MHz and connect to GPIOs
-    spi_init(Pins::SpiInst, 2'000'000);
-    spi_set_format(Pins::SpiInst, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
-    spi_set_slave(Pins::SpiInst, false);
-    gpio_init(Pins::ChipSel);
-    gpio_set_function(Pins::Clock, GPIO_FUNC_SPI);
-    gpio_set_function(Pins::Mosi, GPIO_FUNC_SPI);
+// The last few things to have gone wrong.
+struct ErrorHistory {
+  enum Kind : uint8_t { DecodeFailed = 1, NoIntactImages, BusyTimeout };
+  struct Error {
+    uint32_t refresh; // Counters::refreshes when it happened
+    uint16_t image_id;
+    uint8_t kind;
+  };
+  std::array<Error, 4> errors;
+  // Where the next goes in `errors`.
+  uint32_t next;
 
-    // Chip select is active-low, so we'll initialise it to a driven-high state
-    gpio_init(Pins::ChipSel);
-    gpio_set_dir(Pins::ChipSel, GPIO_OUT);
-    gpio_put(Pins::ChipSel, true);
+  void add(uint32_t refresh, Kind kind, size_t image_id) {
+    errors[next++ % errors.size()] = {refresh,
+                                      static_cast<uint16_t>(image_id), kind};
+  }
+};
 
-    // Reset select is active-low, so we'll initialise it to a driven-high state
-    gpio_init(Pins::Reset);
-    gpio_set_dir(Pins::Reset, GPIO_OUT);
-    gpio_put(Pins::Reset, true);
+#if defined(FRAME_PREFETCH) && defined(FRAME_DUAL_CORE)
+static FrameDecoder core0_decoder;
+static FrameDecoder core1_decoder;
 
-    gpio_init(Pins::Dc);
-    gpio_set_dir(Pins::Dc, GPIO_OUT);
-    gpio_init(Pins::Busy);
-    gpio_set_dir(Pins::Busy, GPIO_IN);
+// Core 1 decodes the odd bands of each frame core 0 posts, and posts back
+// whether they were all good.
+static void core1_main() {
+  for (;;) {
+    const auto word = multicore_fifo_pop_blocking();
+    if (core1_parked(word))
+      continue;
+    const auto *image = reinterpret_cast<const Image *>(word);
+    auto *frame = reinterpret_cast<uint8_t *>(multicore_fifo_pop_blocking());
+    multicore_fifo_push_blocking(core1_decoder.decode(*image, frame, 1, 2));
   }
+}
 
-  void reset() {
-    gpio_put(Pins::Reset, true);
-    sleep_ms(200);
-    gpio_put(Pins::Reset, false);
-    sleep_ms(2);
-    gpio_put(Pins::Reset, true);
-    busy_high();
-  }
+static bool decode_on_both_cores(const Image &image, uint8_t *frame) {
+  multicore_fifo_push_blocking(reinterpret_cast<uintptr_t>(&image));
+  multicore_fifo_push_blocking(reinterpret_cast<uintptr_t>(frame));
+  const bool ok = core0_decoder.decode(image, frame, 0, 2);
+  return core1_fifo_pop() && ok;
+}
 
-  void init() {
-    reset();
-    // App manual agrees
-    send_command(0x00, 0xef, 0x08);
-    // App manual says send 0x01 0x37 0x00 0x05 0x05.
-    send_command(0x01, 0x37, 0x00, 0x23, 0x23);
-    // App manual agrees
-    send_command(0x03, 0x00);
-    // App manual agrees
-    send_command(0x06, 0xc7, 0xc7, 0x1d);
-    // App manual says "flash frame rate" here for data
-    send_command(0x30, 0x3c);
-    // App manual says command 0x41 here, data 0
-    send_command(0x40, 0x00);
-    // App manual agrees
-    // This is "VCOM and Data interval settings"
-    // VBD[2:0] | DDX | CDI[3:0]
-    //          Vbd D CDI
-    //          | | | |  |
-    // 0x37 = 0b001 1 0111
-    // VBD of 001 is "white" (it's a colour, the "vertical back porch").
-    // DDX = 1 is LUT one "default" (b/w/g/b/r/y/o/X)
-    // CDI is "data interval", 7 is default of "10"
-    // timing diagram shows vsync/hsync timings, frame data is delayed by this
-    // many (hsyncs?) units.
-    send_command(0x50, 0x37);
-    // App manual agrees, though 0x60 is not listed in the data sheet.
-    send_command(0x60, 0x22);
-    // App manual agrees
-    set_res();
-    // App manual agrees
-    send_command(0xe3, 0xaa);
-    // App manual says 0x82 and "flash vcom".
-    // Datasheet says "Vcom_DC setting" and mentions voltages, from -0.1V down
-    // to -4V. VCOM is "common voltage" which is presumably the power to the
-    // screen? Referenced in many display docs, and is usually negative.
-  }
+static Prefetcher prefetcher(decode_on_both_cores);
+static constexpr size_t decoder_bytes =
+    sizeof(core0_decoder) + sizeof(core1_decoder) + sizeof(prefetcher);
+#elif defined(FRAME_PREFETCH)
+static Prefetcher prefetcher;
+// Plus decode_frame()'s decoder.
+static constexpr size_t decoder_bytes =
+    sizeof(prefetcher) + sizeof(FrameDecoder);
+#elif defined(FRAME_DUAL_CORE)
+static DecodePipeline pipeline;
+static constexpr size_t decoder_bytes = sizeof(pipeline);
 
-  void clear(uint colour) {
-    set_res();
-    send_command(0x10);
-    send_repeated_data(colour | (colour << 4), Width * Height / 2);
-    screen_refresh();
-  }
-  void rainbow() {
-    set_res();
-    send_command(0x10);
-    for (auto band = 0; band < 8; ++band) {
-      send_repeated_data(band | (band << 4), Width * Height / 2 / 8);
-    }
-    screen_refresh();
-  }
-  void screen_refresh() {
-    send_command(0x04);
-    busy_high();
-    send_command(0x12);
-    busy_high();
-    send_command(0x02);
-    busy_low();
-    sleep_ms(
-        200); // TODO: have seen "blank image" without it BUT SRSLY can't be!
-  }
-  void set_res() {
-    // This is setting the screen resolution.
-    send_command(0x61, high_byte(Width), low_byte(Width), high_byte(Height),
-                 low_byte(Height));
-  }
-  void image(const uint8_t *data) {
-    set_res();
-    send_command(0x10, data, Width * Height / 2);
-    screen_refresh();
+// Core 1 decodes whichever image core 0 posts through the inter-core FIFO,
+// stalling whenever core 0 falls behind draining the ring to the panel.
+static void core1_main() {
+  for (;;) {
+    const auto word = multicore_fifo_pop_blocking();
+    if (core1_parked(word))
+      continue;
+    pipeline.produce(*reinterpret_cast<const Image *>(word));
   }
-  void sleep() { send_command(0x07, 0xa5); }
-};
+}
+#elif defined(FRAME_STREAM_DECODE)
+static constexpr size_t decoder_bytes = sizeof(StreamDecoder);
+#else
+// decode_frame()'s decoder and the frame buffer.
+static constexpr size_t decoder_bytes =
+    sizeof(FrameDecoder) + Screen::FrameBytes;
+#endif // FRAME_PREFETCH / FRAME_DUAL_CORE
 
-volatile bool orientation_changed = false;
+#ifdef FRAME_XIP_STREAM
+// The buffers bands are staged in, shared by the decoders.
+static constexpr size_t stage_bytes = 2 * BandStageBytes;
+#else
+static constexpr size_t stage_bytes = 0;
+#endif
 
-void gpio_callback(uint gpio, uint32_t events) {
-  gpio_acknowledge_irq(gpio, events);
-  orientation_changed = true;
+// Decoder state is all static and sized at compile time, and miniz is built
+// with MINIZ_NO_MALLOC, so decoding never touches the heap. The first figure
+// is that static state's size, not a measurement; newlib's heap only grows,
+// so its size is the peak anything else has used.
+static void report_memory() {
+  debug("memory: %zu bytes of static decoder state, heap peak %zu bytes",
+        decoder_bytes + stage_bytes, static_cast<size_t>(mallinfo().arena));
+}
+
+// Clears the panel and shows `image` on it. Returns false if the image
+// failed to decode, in which case the panel is left cleared rather than
+// refreshed with a broken frame. `state` is flushed while the clear runs,
+// once nothing else needs flash or core 1.
+static bool show_image(Screen &screen, [[maybe_unused]] const Image &image,
+                       [[maybe_unused]] bool orientation, StateLog &state) {
+  // The clear takes as long as any other refresh. With a frame buffer we
+  // decompress meanwhile; streaming has to wait for the panel instead, but
+  // overlaps the upload with the inflate.
   gpio_put(Pins::Led, true);
-  __sev();
+  auto clearing = screen.start_clear(0x7);
+#if defined(FRAME_PREFETCH)
+  // Normally decoded while we slept; if the frame was turned it's decoded
+  // now, while the clear runs.
+  const auto *frame = prefetcher.frame(orientation);
+  state.flush();
+  clearing.wait();
+  gpio_put(Pins::Led, false);
+  if (!frame)
+    return false;
+  screen.image(frame);
+  return true;
+#elif defined(FRAME_DUAL_CORE) || defined(FRAME_STREAM_DECODE)
+  state.flush();
+#if defined(FRAME_DUAL_CORE)
+  // Core 1 starts decoding now and fills the ring while the clear finishes.
+  multicore_fifo_push_blocking(reinterpret_cast<uintptr_t>(&image));
+#endif
+  clearing.wait();
+  gpio_put(Pins::Led, false);
+  screen.begin_upload();
+#if defined(FRAME_DUAL_CORE)
+  auto result = pipeline.drain(screen.transport());
+#else
+  static StreamDecoder decoder;
+  auto result = decoder.decode(image, screen.transport());
+#endif
+  debug("streamed %d bytes", result);
+  // A stream that fails its checks (the Adler-32 comes last) is only known
+  // bad once it's been sent, so it's dropped without the refresh.
+  if (result != static_cast<int32_t>(Screen::FrameBytes)) {
+    screen.abort_upload();
+    return false;
+  }
+  screen.end_upload().wait();
+  return true;
+#else
+  alignas(4) static std::array<uint8_t, Screen::FrameBytes> decom_buf;
+  auto result = decode_frame(image, decom_buf.data());
+  debug("decode result: %d", result);
+  state.flush();
+  clearing.wait();
+  gpio_put(Pins::Led, false);
+  if (!result)
+    return false;
+  screen.image(decom_buf.data());
+  return true;
+#endif
 }
 
-static int64_t sev_callback(alarm_id_t, void *) {
-  __sev();
-  return 0;
+// A seed for a new shuffle, from the ring oscillator's jitter: the time
+// since boot is much the same every boot.
+static uint32_t random_seed() {
+  uint32_t seed = 0;
+  for (int bit = 0; bit < 32; ++bit)
+    seed = seed << 1 | (rosc_hw->randombit & 1);
+  return seed;
 }
 
 void show_all_colours(Screen &screen) {
@@ -251,8 +235,16 @@ int main() {
   stdio_init_all();
 #endif
 
-  Screen screen;
+#ifdef FRAME_PIO_TRANSPORT
+  PioTransport transport(pio0, 2'000'000);
+#else
+  SpiTransport transport(Pins::SpiInst, 2'000'000);
+#endif
+  Screen screen(transport);
   screen.init();
+#ifdef FRAME_DUAL_CORE
+  multicore_launch_core1(core1_main);
+#endif
 
   gpio_init(Pins::Led);
   gpio_set_dir(Pins::Led, GPIO_OUT);
@@ -263,36 +255,86 @@ int main() {
 
   //  show_all_colours(screen);
 
-  size_t image_id = time_us_32() % Image::NumImages;
+  const auto images = image_list();
+  // Carry on through the shuffle from where the last power cycle left it.
+  DeviceFlash flash;
+  StateLog state(flash);
+  PositionLog positions(state);
+  Playlist playlist(random_seed());
+  if (Playlist::Position position; positions.load(position))
+    playlist.resume(position);
+  Counters counters{};
+  ErrorHistory errors{};
+  state.get(state_key::Counters, counters);
+  state.get(state_key::Errors, errors);
+  ++counters.boots;
+  state.set(state_key::Counters, counters);
+  auto busy_timeouts = screen.busy_timeouts();
+  uint32_t failures_in_row = 0;
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "EndlessLoop"
   for (;;) {
-    gpio_put(Pins::Led, true);
-    screen.clear(0x7);
-    gpio_put(Pins::Led, false);
-
     bool orientation = gpio_get(Pins::Orientation);
     orientation_changed = false;
     debug("orientation: %d", orientation);
-    for (auto offset = 0; offset < Image::NumImages; ++offset) {
-      if (Image::Images[image_id].portrait == orientation)
-        break;
-      image_id++;
-      if (image_id >= Image::NumImages)
-        image_id = 0;
+    // Picking an image checks its CRC, so a corrupt one is passed over
+    // before anything reaches the panel.
+#ifdef FRAME_PREFETCH
+    prefetcher.plan(playlist);
+    const auto image_id = prefetcher.image_id(orientation);
+    playlist.next(orientation);
+#else
+    const auto image_id = playlist.next(orientation);
+#endif
+    positions.save(playlist.position());
+    bool shown = false;
+    if (image_id == NoImage) {
+      debug("No intact images!");
+      errors.add(counters.refreshes, ErrorHistory::NoIntactImages, image_id);
+    } else {
+      const auto &image = images[image_id];
+      debug("image: %s", image.name);
+      shown = show_image(screen, image, orientation, state);
+      if (shown) {
+        debug("done (last busy wait %lu us)", screen.last_busy_wait_us());
+        ++counters.refreshes;
+      } else {
+        debug("%s didn't decode; moving on", image.name);
+        ++counters.decode_failures;
+        errors.add(counters.refreshes, ErrorHistory::DecodeFailed, image_id);
+      }
+      report_memory();
     }
-    const auto &image = Image::Images[image_id];
-    debug("image: %s", image.name);
-    static std::array<uint8_t, Screen::Width * Screen::Height / 2> decom_buf;
-    auto dest_len = static_cast<mz_ulong>(decom_buf.size());
-    auto result = mz_uncompress(decom_buf.data(), &dest_len,
-                                image.compressed_data, image.compressed_size);
-    debug("decompress results: %d", result);
-    screen.image(decom_buf.data());
-    debug("done");
+    if (screen.busy_timeouts() != busy_timeouts) {
+      counters.busy_timeouts += screen.busy_timeouts() - busy_timeouts;
+      busy_timeouts = screen.busy_timeouts();
+      errors.add(counters.refreshes, ErrorHistory::BusyTimeout, image_id);
+    }
+    // Written during the next clear, along with the position then.
+    state.set(state_key::Counters, counters);
+    state.set(state_key::Errors, errors);
     screen.sleep();
+#ifdef FRAME_PREFETCH
+    // Decode the next image for this orientation before idling.
+    prefetcher.plan(playlist);
+    prefetcher.prefetch(orientation);
+#endif
 
-    constexpr auto sleep_secs = 5 * 60;
+    // A failed image has still cost a clear, so rather than clearing the
+    // panel back-to-back, wait a while before the next: 10s, doubling with
+    // each failure in a row up to the usual five minutes.
+    constexpr uint32_t ShowSecs = 5 * 60;
+    constexpr uint32_t RetrySecs = 10;
+    auto sleep_secs = ShowSecs;
+    if (shown || image_id == NoImage) {
+      failures_in_row = 0;
+    } else {
+      sleep_secs = std::min(ShowSecs, RetrySecs << failures_in_row);
+      failures_in_row = std::min<uint32_t>(failures_in_row + 1, 5);
+    }
+    // With no images there's no clear to flush during.
+    if (image_id == NoImage)
+      state.flush();
     const auto target_sleep_time =
         make_timeout_time_us(sleep_secs * (1000ul * 1000ul));
     auto looped_times = 0ul;
@@ -311,9 +353,6 @@ int main() {
       debug("Orientation changed!");
     }
     screen.init();
-    image_id++;
-    if (image_id >= Image::NumImages)
-      image_id = 0;
   }
 #pragma clang diagnostic pop
 }
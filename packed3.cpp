@@ -0,0 +1,73 @@
+#include "packed3.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Two 3-bit pixels to one nibble-pair byte.
+constexpr auto PairTable = [] {
+  std::array<uint8_t, 64> table{};
+  for (size_t i = 0; i < table.size(); ++i)
+    table[i] = static_cast<uint8_t>(((i >> 3) << 4) | (i & 7));
+  return table;
+}();
+
+} // namespace
+
+void packed3::unpack(const uint8_t *in, uint8_t *out, size_t groups) {
+  for (; groups; --groups, in += GroupPackedBytes, out += GroupBytes) {
+    // All three bytes are read before anything is written, which is what
+    // makes unpacking in place safe.
+    const uint32_t bits = (uint32_t{in[0]} << 16) | (uint32_t{in[1]} << 8) |
+                          uint32_t{in[2]};
+    const uint32_t word = uint32_t{PairTable[bits >> 18]} |
+                          uint32_t{PairTable[(bits >> 12) & 63]} << 8 |
+                          uint32_t{PairTable[(bits >> 6) & 63]} << 16 |
+                          uint32_t{PairTable[bits & 63]} << 24;
+    std::memcpy(__builtin_assume_aligned(out, 4), &word, sizeof(word));
+  }
+}
+
+void Packed3Unpacker::send(const uint8_t *packed, size_t groups) {
+  while (groups) {
+    auto batch = std::min(groups, BufferGroups);
+    auto &buffer = buffers_[next_buffer_];
+    next_buffer_ ^= 1;
+    // The downstream start_data() waits out the last transfer, which is the
+    // one reading the *other* buffer, so this one is free.
+    packed3::unpack(packed, buffer.data(), batch);
+    out_->start_data(buffer.data(), batch * packed3::GroupBytes);
+    packed += batch * packed3::GroupPackedBytes;
+    groups -= batch;
+  }
+}
+
+void Packed3Unpacker::start_data(const uint8_t *data, size_t length) {
+  if (carry_length_) {
+    auto take = std::min(length, carry_.size() - carry_length_);
+    std::copy_n(data, take, carry_.data() + carry_length_);
+    carry_length_ += take;
+    data += take;
+    length -= take;
+    if (carry_length_ < carry_.size())
+      return;
+    send(carry_.data(), 1);
+    carry_length_ = 0;
+  }
+  const auto groups = length / packed3::GroupPackedBytes;
+  send(data, groups);
+  carry_length_ = length - groups * packed3::GroupPackedBytes;
+  std::copy_n(data + groups * packed3::GroupPackedBytes, carry_length_,
+              carry_.data());
+}
+
+void Packed3Unpacker::start_fill(uint8_t value, size_t length) {
+  std::array<uint8_t, 48> block;
+  block.fill(value);
+  while (length) {
+    auto piece = std::min(length, block.size());
+    start_data(block.data(), piece);
+    length -= piece;
+  }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "transport.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// The panel only has eight colour indices, so frames can be stored 3 bits per
+// pixel: eight pixels in three bytes, packed MSB first, against four bytes
+// in the panel's nibble layout.
+namespace packed3 {
+
+constexpr size_t GroupPackedBytes = 3;
+constexpr size_t GroupBytes = 4;
+
+constexpr size_t packed_size(size_t unpacked_bytes) {
+  return unpacked_bytes / GroupBytes * GroupPackedBytes;
+}
+
+// Expands `groups` groups of packed pixels into the nibble layout. `out` must
+// be word aligned. It may overlap `in` as long as it starts at least
+// `groups` bytes before it (as when unpacking a frame in place from the end
+// of its buffer).
+void unpack(const uint8_t *in, uint8_t *out, size_t groups);
+
+// Unpacks a frame in place: the packed data must already sit at
+// `frame + (size - packed_size(size))`.
+inline void unpack_in_place(uint8_t *frame, size_t size) {
+  unpack(frame + size - packed_size(size), frame, size / GroupBytes);
+}
+
+} // namespace packed3
+
+// Sits in front of another transport and unpacks 3-bit data into the nibble
+// layout on its way through. Unpacks into two buffers in turn, so one can be
+// filled while the other is sent.
+class Packed3Unpacker final : public Transport {
+public:
+  // Where unpacked data goes; must be set before each new stream.
+  void set_output(Transport &out) {
+    out_ = &out;
+    carry_length_ = 0;
+  }
+
+  using Transport::command;
+  void command(uint8_t command, const uint8_t *params,
+               size_t length) override {
+    out_->command(command, params, length);
+  }
+  void start_data(const uint8_t *data, size_t length) override;
+  void start_fill(uint8_t value, size_t length) override;
+  void open_data() override { out_->open_data(); }
+  void close_data() override { out_->close_data(); }
+  [[nodiscard]] bool busy() const override { return out_->busy(); }
+  void wait() override { out_->wait(); }
+
+private:
+  static constexpr size_t BufferGroups = 256;
+
+  void send(const uint8_t *packed, size_t groups);
+
+  Transport *out_ = nullptr;
+  std::array<uint8_t, packed3::GroupPackedBytes> carry_{};
+  size_t carry_length_ = 0;
+  size_t next_buffer_ = 0;
+  alignas(4) std::array<std::array<uint8_t, BufferGroups * packed3::GroupBytes>,
+                        2> buffers_{};
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "hardware/spi.h"
+
+struct Pins {
+  static constexpr auto Mosi = 19;
+  static constexpr auto ChipSel = 17;
+  static constexpr auto Clock = 18;
+  static constexpr auto Led = 25;
+  static constexpr auto Dc = 15;
+  static constexpr auto Reset = 14;
+  static constexpr auto Busy = 13;
+  static constexpr auto Orientation = 12;
+  static const inline auto SpiInst = spi0;
+};
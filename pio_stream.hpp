@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Encoder for the tagged word stream consumed by the eink_spi PIO program (see
+// eink_spi.pio for the frame layout). Kept free of SDK dependencies so it can
+// be built and checked on the host.
+namespace pio_stream {
+
+constexpr uint32_t CommandFlag = 1u << 31;
+constexpr auto CommandShift = 23;
+constexpr uint32_t BitCountMask = (1u << CommandShift) - 1;
+constexpr size_t MaxFrameBytes = BitCountMask / 8;
+// Largest single command: header plus 255 parameter bytes.
+constexpr size_t MaxCommandWords = 1 + (255 + 3) / 4;
+
+constexpr size_t words_for(size_t bytes) { return (bytes + 3) / 4; }
+
+// Bytes in the next data frame when `remaining` are left to send; longer
+// uploads are split into several frames.
+constexpr size_t frame_bytes(size_t remaining) {
+  return remaining < MaxFrameBytes ? remaining : MaxFrameBytes;
+}
+
+constexpr uint32_t command_header(uint8_t command, size_t param_bytes) {
+  return CommandFlag | (uint32_t{command} << CommandShift) |
+         static_cast<uint32_t>(param_bytes * 8);
+}
+
+constexpr uint32_t data_header(size_t bytes) {
+  return static_cast<uint32_t>(bytes * 8);
+}
+
+// A payload word that sends `value` four times.
+constexpr uint32_t fill_word(uint8_t value) { return value * 0x01010101u; }
+
+// Packs `length` bytes MSB first into `out`, zero-padding the final word.
+// Returns the number of words written.
+constexpr size_t pack(const uint8_t *bytes, size_t length, uint32_t *out) {
+  size_t words = 0;
+  for (size_t i = 0; i < length; i += 4) {
+    uint32_t word = 0;
+    for (size_t j = 0; j < 4; ++j)
+      word = (word << 8) | (i + j < length ? bytes[i + j] : 0);
+    out[words++] = word;
+  }
+  return words;
+}
+
+// Encodes a whole command frame into `out`, which needs room for
+// `1 + words_for(length)` words. Returns the number of words written.
+constexpr size_t encode_command(uint8_t command, const uint8_t *params,
+                                size_t length, uint32_t *out) {
+  out[0] = command_header(command, length);
+  return 1 + pack(params, length, out + 1);
+}
+
+// Number of words `encode_data()` needs for `length` bytes.
+constexpr size_t encoded_data_size(size_t length) {
+  size_t words = 0;
+  do {
+    const auto frame = frame_bytes(length);
+    words += 1 + words_for(frame);
+    length -= frame;
+  } while (length);
+  return words;
+}
+
+// Encodes `length` bytes as data frames of at most MaxFrameBytes into
+// `out`, which needs room for `encoded_data_size(length)` words. Returns
+// the number of words written.
+constexpr size_t encode_data(const uint8_t *data, size_t length,
+                             uint32_t *out) {
+  size_t words = 0;
+  do {
+    const auto frame = frame_bytes(length);
+    out[words] = data_header(frame);
+    words += 1 + pack(data, frame, out + words + 1);
+    data += frame;
+    length -= frame;
+  } while (length);
+  return words;
+}
+
+// Number of words `encode_commands()` needs for a `command_table()`.
+constexpr size_t encoded_commands_size(const uint8_t *table, size_t size) {
+  size_t words = 0;
+  for (size_t pos = 0; pos + 2 <= size; pos += 2 + table[pos + 1])
+    words += 1 + words_for(table[pos + 1]);
+  return words;
+}
+
+// Encodes every command in a `command_table()` back to back. Returns the
+// number of words written.
+constexpr size_t encode_commands(const uint8_t *table, size_t size,
+                                 uint32_t *out) {
+  size_t words = 0;
+  for (size_t pos = 0; pos + 2 <= size; pos += 2 + table[pos + 1])
+    words += encode_command(table[pos], table + pos + 2, table[pos + 1],
+                            out + words);
+  return words;
+}
+
+} // namespace pio_stream
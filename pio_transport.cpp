@@ -0,0 +1,136 @@
+#include "pio_transport.hpp"
+
+#include "eink_spi.pio.h"
+#include "pins.hpp"
+
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/stdlib.h" // NOLINT(modernize-deprecated-headers)
+
+#include <algorithm>
+
+static_assert(Pins::ChipSel == Pins::Dc + 2,
+              "eink_spi.pio sets DC and CS through one three-pin SET group");
+
+PioTransport::PioTransport(PIO pio, uint baud)
+    : pio_(pio), sm_(pio_claim_unused_sm(pio, true)),
+      offset_(pio_add_program(pio, &eink_spi_program)) {
+  auto clkdiv = static_cast<float>(clock_get_hz(clk_sys)) /
+                static_cast<float>(baud * eink_spi_cycles_per_bit);
+  eink_spi_program_init(pio_, sm_, offset_, clkdiv, Pins::Mosi, Pins::Clock,
+                        Pins::Dc, Pins::ChipSel);
+
+  dma_channel_ = dma_claim_unused_channel(true);
+  instance_ = this;
+  irq_set_exclusive_handler(DMA_IRQ_0, dma_irq_handler);
+  dma_channel_set_irq0_enabled(dma_channel_, true);
+  irq_set_enabled(DMA_IRQ_0, true);
+}
+
+PioTransport::~PioTransport() {
+  wait();
+  dma_channel_set_irq0_enabled(dma_channel_, false);
+  irq_set_enabled(DMA_IRQ_0, false);
+  dma_channel_unclaim(dma_channel_);
+  pio_sm_set_enabled(pio_, sm_, false);
+  pio_remove_program(pio_, &eink_spi_program, offset_);
+  pio_sm_unclaim(pio_, sm_);
+  instance_ = nullptr;
+}
+
+void PioTransport::dma_irq_handler() {
+  auto *self = instance_;
+  dma_channel_acknowledge_irq0(self->dma_channel_);
+  self->dma_running_ = false;
+  __sev();
+}
+
+void PioTransport::put(uint32_t word) { pio_sm_put_blocking(pio_, sm_, word); }
+
+void PioTransport::start_dma(const void *words, size_t count, bool increment,
+                             bool bswap) {
+  auto config = dma_channel_get_default_config(dma_channel_);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+  channel_config_set_dreq(&config, pio_get_dreq(pio_, sm_, true));
+  channel_config_set_read_increment(&config, increment);
+  channel_config_set_write_increment(&config, false);
+  channel_config_set_bswap(&config, bswap);
+  dma_running_ = true;
+  dma_channel_configure(dma_channel_, &config, &pio_->txf[sm_], words, count,
+                        true);
+}
+
+void PioTransport::command(uint8_t command, const uint8_t *params,
+                           size_t length) {
+  wait();
+  auto words = pio_stream::encode_command(command, params, length,
+                                          stream_.data());
+  for (size_t i = 0; i < words; ++i)
+    put(stream_[i]);
+}
+
+void PioTransport::commands(const uint8_t *table, size_t size) {
+  wait();
+  if (pio_stream::encoded_commands_size(table, size) > stream_.size()) {
+    Transport::commands(table, size);
+    return;
+  }
+  auto words = pio_stream::encode_commands(table, size, stream_.data());
+  start_dma(stream_.data(), words, true, false);
+}
+
+void PioTransport::start_data(const uint8_t *data, size_t length) {
+  wait();
+  while (length) {
+    auto frame = pio_stream::frame_bytes(length);
+    put(pio_stream::data_header(frame));
+    if (reinterpret_cast<uintptr_t>(data) % 4 == 0) {
+      // Byte-swapping the words puts the first byte in the MSB, which is
+      // where the PIO shifts from. Reading all of the last word is safe even
+      // past the end of `data` as it's aligned, and the PIO drops the excess.
+      start_dma(data, pio_stream::words_for(frame), true, true);
+    } else {
+      // Unaligned data can't be swapped by the DMA; pack it on the CPU.
+      for (size_t done = 0; done < frame;) {
+        auto chunk = std::min(frame - done, stream_.size() * 4);
+        auto words = pio_stream::pack(data + done, chunk, stream_.data());
+        for (size_t i = 0; i < words; ++i)
+          put(stream_[i]);
+        done += chunk;
+      }
+    }
+    data += frame;
+    length -= frame;
+    if (length)
+      wait();
+  }
+}
+
+void PioTransport::start_fill(uint8_t value, size_t length) {
+  wait();
+  fill_word_ = pio_stream::fill_word(value);
+  while (length) {
+    auto frame = pio_stream::frame_bytes(length);
+    put(pio_stream::data_header(frame));
+    start_dma(&fill_word_, pio_stream::words_for(frame), false, false);
+    length -= frame;
+    if (length)
+      wait();
+  }
+}
+
+bool PioTransport::idle() const {
+  // Between frames the state machine stalls on the `pull` at its wrap target.
+  return pio_sm_is_tx_fifo_empty(pio_, sm_) &&
+         pio_sm_get_pc(pio_, sm_) == offset_;
+}
+
+bool PioTransport::busy() const { return dma_running_ || !idle(); }
+
+void PioTransport::wait() {
+  while (dma_running_)
+    __wfe();
+  while (!idle())
+    tight_loop_contents();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "pio_stream.hpp"
+#include "transport.hpp"
+
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+
+#include <array>
+
+// Drives the panel from a PIO state machine running eink_spi.pio, which
+// handles DC, chip select, their timing and the clock itself. We only feed it
+// the word stream from pio_stream.hpp: word-aligned data and fills go straight
+// from memory to the TX FIFO by DMA, so a frame upload costs no CPU per byte.
+class PioTransport final : public Transport {
+public:
+  PioTransport(PIO pio, uint baud);
+  ~PioTransport() override;
+  PioTransport(const PioTransport &) = delete;
+  PioTransport &operator=(const PioTransport &) = delete;
+
+  using Transport::command;
+  void command(uint8_t command, const uint8_t *params,
+               size_t length) override;
+  void commands(const uint8_t *table, size_t size) override;
+  void start_data(const uint8_t *data, size_t length) override;
+  void start_fill(uint8_t value, size_t length) override;
+  [[nodiscard]] bool busy() const override;
+  void wait() override;
+
+private:
+  static void dma_irq_handler();
+  void put(uint32_t word);
+  void start_dma(const void *words, size_t count, bool increment, bool bswap);
+  [[nodiscard]] bool idle() const;
+
+  static inline PioTransport *instance_ = nullptr;
+  PIO pio_;
+  uint sm_;
+  uint offset_;
+  uint dma_channel_;
+  volatile bool dma_running_ = false;
+  uint32_t fill_word_ = 0;
+  // Encoded commands, and the odd unaligned data chunk, are staged here.
+  std::array<uint32_t, 64> stream_{};
+};
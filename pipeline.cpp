@@ -0,0 +1,72 @@
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+DecodePipeline::Ring::Chunk &DecodePipeline::RingWriter::current() {
+  if (!chunk_) {
+    chunk_ = &ring_.acquire();
+    chunk_->length = 0;
+    chunk_->last = false;
+    chunk_->status = 0;
+  }
+  return *chunk_;
+}
+
+void DecodePipeline::RingWriter::flush() {
+  ring_.publish();
+  chunk_ = nullptr;
+}
+
+void DecodePipeline::RingWriter::start_data(const uint8_t *data,
+                                            size_t length) {
+  while (length) {
+    auto &chunk = current();
+    auto piece = std::min(length, ChunkSize - chunk.length);
+    std::memcpy(chunk.data.data() + chunk.length, data, piece);
+    chunk.length += piece;
+    data += piece;
+    length -= piece;
+    if (chunk.length == ChunkSize)
+      flush();
+  }
+}
+
+void DecodePipeline::RingWriter::start_fill(uint8_t value, size_t length) {
+  while (length) {
+    auto &chunk = current();
+    auto piece = std::min(length, ChunkSize - chunk.length);
+    std::memset(chunk.data.data() + chunk.length, value, piece);
+    chunk.length += piece;
+    length -= piece;
+    if (chunk.length == ChunkSize)
+      flush();
+  }
+}
+
+void DecodePipeline::RingWriter::finish(int32_t status) {
+  auto &chunk = current();
+  chunk.last = true;
+  chunk.status = status;
+  flush();
+}
+
+void DecodePipeline::produce(const Image &image) {
+  writer_.finish(decoder_.decode(image, writer_));
+}
+
+int32_t DecodePipeline::drain(Transport &out) {
+  for (;;) {
+    // The producer keeps filling the rest of the ring while this chunk is
+    // in flight, so we only hand it back once the transfer is done.
+    const auto &chunk = ring_.peek();
+    if (chunk.length)
+      out.start_data(chunk.data.data(), chunk.length);
+    out.wait();
+    const bool last = chunk.last;
+    const auto status = chunk.status;
+    ring_.release();
+    if (last)
+      return status;
+  }
+}
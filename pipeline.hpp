@@ -0,0 +1,53 @@
+#pragma once
+
+#include "chunk_ring.hpp"
+#include "decode.hpp"
+#include "images.hpp"
+#include "transport.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Splits an image between two cores: `produce()` inflates (and does any
+// other per-image processing) into a ring of chunks, while `drain()` sends
+// the chunks to the panel as they arrive. Each side is meant for its own core
+// (or thread, on the host); the ring provides the backpressure.
+class DecodePipeline {
+public:
+  static constexpr size_t ChunkSize = 4096;
+  static constexpr size_t NumChunks = 4;
+  using Ring = ChunkRing<ChunkSize, NumChunks>;
+
+  // Producer: decodes one image into the ring, finishing with a chunk marked
+  // `last` that carries the decoder's result.
+  void produce(const Image &image);
+  // Consumer: sends chunks to `out` until the last one. Returns the
+  // producer's result.
+  int32_t drain(Transport &out);
+
+private:
+  // The producer's view of the ring, so the decoder can write to it as if it
+  // were the panel.
+  class RingWriter final : public Transport {
+  public:
+    explicit RingWriter(Ring &ring) : ring_(ring) {}
+    using Transport::command;
+    void command(uint8_t, const uint8_t *, size_t) override {}
+    void start_data(const uint8_t *data, size_t length) override;
+    void start_fill(uint8_t value, size_t length) override;
+    [[nodiscard]] bool busy() const override { return false; }
+    void wait() override {}
+    void finish(int32_t status);
+
+  private:
+    Ring::Chunk &current();
+    void flush();
+
+    Ring &ring_;
+    Ring::Chunk *chunk_ = nullptr;
+  };
+
+  Ring ring_;
+  StreamDecoder decoder_;
+  RingWriter writer_{ring_};
+};
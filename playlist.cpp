@@ -0,0 +1,113 @@
+#include "playlist.hpp"
+
+#include "decode.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// A well-mixing 32-bit hash, for the round keys and function.
+uint32_t mix(uint32_t value) {
+  value ^= value >> 16;
+  value *= 0x7feb352d;
+  value ^= value >> 15;
+  value *= 0x846ca68b;
+  value ^= value >> 16;
+  return value;
+}
+
+// Slots in a pass of `count` images: MaxWeight for each, of which an image
+// with weight w fills the first w.
+uint32_t slots(size_t count) { return count * Playlist::MaxWeight; }
+
+// The order of a pass's slots for one orientation.
+Feistel shuffle(uint32_t seed, uint32_t pass, bool portrait, uint32_t size) {
+  return {size, seed ^ mix(pass << 1 | portrait)};
+}
+
+} // namespace
+
+Feistel::Feistel(uint32_t size, uint32_t key) : size_(size) {
+  while ((1u << (2 * half_bits_)) < size)
+    ++half_bits_;
+  for (size_t round = 0; round < Rounds; ++round)
+    keys_[round] = key = mix(key + round);
+}
+
+uint32_t Feistel::permute(uint32_t value) const {
+  const uint32_t mask = (1u << half_bits_) - 1;
+  uint32_t left = value >> half_bits_;
+  uint32_t right = value & mask;
+  for (const auto key : keys_) {
+    const auto next = left ^ (mix(right ^ key) & mask);
+    left = right;
+    right = next;
+  }
+  return left << half_bits_ | right;
+}
+
+uint32_t Feistel::operator()(uint32_t index) const {
+  // At most 4 * size values to walk through, and usually one or two.
+  do
+    index = permute(index);
+  while (index >= size_);
+  return index;
+}
+
+Playlist::Playlist(uint32_t seed) : position_{seed, {}, {}, {}} {
+  const auto images = image_list();
+  for (const bool way : {false, true})
+    position_.count[way] = static_cast<uint16_t>(images.count[way]);
+}
+
+void Playlist::resume(const Position &position) {
+  const uint16_t current[2] = {position_.count[0], position_.count[1]};
+  position_ = position;
+  for (const bool way : {false, true}) {
+    if (position_.count[way] != current[way] ||
+        position_.place[way] >= slots(current[way])) {
+      position_.count[way] = current[way];
+      position_.place[way] = 0;
+    }
+  }
+}
+
+Playlist::Found Playlist::find(bool portrait) const {
+  const auto images = image_list();
+  for (const bool way : {portrait, !portrait}) {
+    const auto count = images.count[way];
+    const auto total = slots(count);
+    auto pass = position_.pass[way];
+    auto place = position_.place[way];
+    auto order = shuffle(position_.seed, pass, way, total);
+    // A pass's worth of slots holds every image with a weight.
+    for (uint32_t step = 0; step < total; ++step) {
+      const auto slot = order(place);
+      const auto image_id = images.by_orientation[way][slot % count];
+      const auto &image = images[image_id];
+      if (slot / count < std::min<uint32_t>(image.weight, MaxWeight) &&
+          image_intact(image))
+        return {image_id, way, pass, place};
+      if (++place == total) {
+        place = 0;
+        order = shuffle(position_.seed, ++pass, way, total);
+      }
+    }
+  }
+  return {NoImage, portrait, 0, 0};
+}
+
+size_t Playlist::next(bool portrait) {
+  const auto found = find(portrait);
+  if (found.image_id != NoImage) {
+    auto &pass = position_.pass[found.portrait];
+    auto &place = position_.place[found.portrait];
+    pass = found.pass;
+    place = found.place + 1;
+    if (place == slots(position_.count[found.portrait])) {
+      place = 0;
+      ++pass;
+    }
+  }
+  return found.image_id;
+}
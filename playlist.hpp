@@ -0,0 +1,76 @@
+#pragma once
+
+#include "image_store.hpp"
+#include "images.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// What the playlist returns when no image is intact.
+constexpr size_t NoImage = ~size_t{0};
+
+// A keyed permutation of [0, size): a four-round Feistel network over the
+// smallest even number of bits that covers `size`, walking the cycle past
+// anything out of range. Any index maps in O(1) with no table, and each
+// key gives a different order.
+class Feistel {
+public:
+  Feistel(uint32_t size, uint32_t key);
+  // Where `index`, which must be below the size, goes.
+  [[nodiscard]] uint32_t operator()(uint32_t index) const;
+
+private:
+  static constexpr size_t Rounds = 4;
+  [[nodiscard]] uint32_t permute(uint32_t value) const;
+
+  uint32_t size_;
+  uint32_t half_bits_ = 1;
+  std::array<uint32_t, Rounds> keys_{};
+};
+
+// Shows the images each way up in a shuffled order, each as many times a
+// pass as its weight, then reshuffles for the next pass, so nothing repeats
+// until everything's been shown. Each orientation has its own queue and
+// place in it, so turning the frame and back carries on where it was.
+class Playlist {
+public:
+  // Weights above this count as this; it bounds the slots in a pass.
+  static constexpr uint32_t MaxWeight = 8;
+
+  // Everything needed to carry on after a reset, indexed by `portrait`.
+  struct Position {
+    uint32_t seed;
+    uint16_t pass[2];
+    uint16_t place[2];
+    // The images each way up when it was saved.
+    uint16_t count[2];
+  };
+
+  // Starts a new shuffle from `seed`.
+  explicit Playlist(uint32_t seed);
+  // Carries on from `position`, but starts the pass again for any
+  // orientation whose images have changed since.
+  void resume(const Position &position);
+  [[nodiscard]] const Position &position() const { return position_; }
+
+  // The image to show `portrait` way up: the next intact one in that
+  // orientation's queue or, if it has none, in the other's. NoImage if no
+  // image is intact (or none has any weight).
+  [[nodiscard]] size_t peek(bool portrait) const {
+    return find(portrait).image_id;
+  }
+  // peek(), then moves that queue on past the image it returns.
+  size_t next(bool portrait);
+
+private:
+  struct Found {
+    size_t image_id;
+    bool portrait;
+    uint16_t pass;
+    uint16_t place;
+  };
+  [[nodiscard]] Found find(bool portrait) const;
+
+  Position position_;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "playlist.hpp"
+#include "state_log.hpp"
+
+#include <cstdint>
+
+// Keeps the playlist's position in the state log, under a key of its own.
+// A save goes out with everything else at the log's next flush(), which the
+// caller times, so a reset loses at most the picks since then.
+class PositionLog {
+public:
+  // The state log key the position is kept under.
+  static constexpr uint16_t Key = 1;
+
+  explicit PositionLog(StateLog &state) : state_(state) {}
+
+  // Sets `position` to the last one saved intact and returns true, or
+  // returns false if there isn't one.
+  bool load(Playlist::Position &position) const {
+    return state_.get(Key, position);
+  }
+  void save(const Playlist::Position &position) { state_.set(Key, position); }
+
+private:
+  StateLog &state_;
+};
@@ -0,0 +1,21 @@
+#include "prefetch.hpp"
+
+#include "debug.hpp"
+
+void Prefetcher::plan(const Playlist &playlist) {
+  next_[false] = playlist.peek(false);
+  next_[true] = playlist.peek(true);
+}
+
+bool Prefetcher::prefetch(bool portrait) {
+  const auto image_id = next_[portrait];
+  if (image_id == NoImage)
+    return false;
+  if (held_ == image_id)
+    return true;
+  const auto &image = image_list()[image_id];
+  const bool ok = decode_(image, buffer_.data());
+  debug("prefetched %s: %d", image.name, ok);
+  held_ = ok ? image_id : NoImage;
+  return ok;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "decode.hpp"
+#include "images.hpp"
+#include "playlist.hpp"
+#include "screen.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Keeps the next frame decoded and ready for when we wake up, so a timer wake
+// only has to upload it. Two 134KB frames won't fit in the RP2040's 264KB, so
+// just one is held: the next image for whichever way up the frame was when it
+// went to sleep. The next image the other way up is chosen at the same time
+// and decoded the moment it's asked for, which the caller overlaps with the
+// pre-image clear.
+class Prefetcher {
+public:
+  // How a frame is decoded; by default all on the calling core.
+  using Decode = bool (*)(const Image &image, uint8_t *frame);
+  explicit Prefetcher(Decode decode = decode_frame) : decode_(decode) {}
+
+  // Picks the images `playlist` would show next each way up. A frame
+  // already held for one of them is kept.
+  void plan(const Playlist &playlist);
+  // Decodes the planned image for `portrait` unless it's already held.
+  // Returns false if it failed to decode, or there's no intact image.
+  bool prefetch(bool portrait);
+  // The planned image for `portrait`, or NoImage.
+  [[nodiscard]] size_t image_id(bool portrait) const { return next_[portrait]; }
+  // The decoded frame for `portrait`, decoding it first if need be, or
+  // nullptr if it won't decode.
+  const uint8_t *frame(bool portrait) {
+    return prefetch(portrait) ? buffer_.data() : nullptr;
+  }
+
+private:
+  Decode decode_;
+  std::array<size_t, 2> next_{};
+  size_t held_ = NoImage;
+  alignas(4) std::array<uint8_t, Screen::FrameBytes> buffer_;
+};
@@ -4,8 +4,12 @@ from typing import Tuple, List, cast
 from PIL import Image, ImageOps
 
 import click
+import collections
 import zlib
 
+import rle
+import row_lz
+
 GAMMA = 1
 WIDTH = 600
 HEIGHT = 448
@@ -38,108 +42,542 @@ def create_palette() -> List[RgbTriple]:
 PALETTE = create_palette()
 
 
-def image_bytes(converted):
-    result = []
-    for y in range(0, HEIGHT):
-        for x in range(0, WIDTH, 2):
-            p1 = converted.getpixel((x, y))
-            p2 = converted.getpixel((x + 1, y))
-            result.append((p1 << 4) | p2)
+# Crops and dithers an image to the panel's size and palette. Returns the
+# paletted image and whether the original was portrait.
+def convert(path):
+    frame_ratio = WIDTH / HEIGHT
+    im = ImageOps.exif_transpose(Image.open(path))
+    portrait = im.height > im.width
+    if portrait:
+        im = im.transpose(Image.ROTATE_90)
+    image_ratio = im.width / im.height
+    if image_ratio > frame_ratio:
+        # Wider, so scale to height, then cut the middle bit out.
+        scale_height = HEIGHT
+        scale_width = int(scale_height * image_ratio)
+    else:
+        scale_width = WIDTH
+        scale_height = int(scale_width / image_ratio)
+    im = im.resize((scale_width, scale_height))
+    if scale_width > WIDTH:
+        lhs = (scale_width / 2) - (WIDTH / 2)
+        rhs = lhs + WIDTH
+        im = im.crop((lhs, 0, rhs, HEIGHT))
+    elif scale_height > HEIGHT:
+        top = (scale_height / 2) - (HEIGHT / 2)
+        bot = top + HEIGHT
+        im = im.crop((0, top, WIDTH, bot))
+    palette_image = Image.new('P', im.size)
+    palette_image.putpalette(list(sum(PALETTE, ())) * 32)
+    palette_image.paste(im, (0, 0) + im.size)
+    converted = im.quantize(
+        colors=len(PALETTE),
+        palette=palette_image,
+        dither=Image.FLOYDSTEINBERG)
+    return converted, portrait
+
+
+def image_bytes(pixels):
+    return bytes((pixels[i] << 4) | pixels[i + 1]
+                 for i in range(0, len(pixels), 2))
+
+
+# The panel only has eight colour indices, so pack eight 3-bit pixels into
+# three bytes, MSB first. The firmware unpacks to the nibble layout.
+def packed3_bytes(pixels):
+    result = bytearray()
+    for i in range(0, len(pixels), 8):
+        word = 0
+        for p in pixels[i:i + 8]:
+            word = (word << 3) | (p & 7)
+        result += word.to_bytes(3, 'big')
     return bytes(result)
 
 
+# As packed3, but each row is split into three bit planes, the top bit of
+# every pixel first. Runs of a colour become runs of set or clear bits in
+# each plane, which deflate matches more easily than 3-bit fields that
+# straddle bytes.
+def planes3_bytes(pixels):
+    result = bytearray()
+    for top in range(0, len(pixels), WIDTH):
+        row = pixels[top:top + WIDTH]
+        for bit in (2, 1, 0):
+            plane = row.translate(bytes(b'01'[(p >> bit) & 1]
+                                        for p in range(256)))
+            result += int(plane, 2).to_bytes(WIDTH // 8, 'big')
+    return bytes(result)
+
+
+FORMATS = {
+    'nibble4': ('Nibble4', image_bytes),
+    'packed3': ('Packed3', packed3_bytes),
+}
+
+# The firmware's Codec values, in order, with their comments there.
+CODECS = {
+    'zlib': ('Zlib', ''),
+    'deflate': ('Deflate', 'raw deflate, against `dictionary` if set'),
+    'rowlz': ('RowLz', 'see row_lz.hpp'),
+    'rle': ('Rle', 'see rle.hpp'),
+}
+# Codecs that decode straight to the panel's layout, so take no format or
+# filters.
+PANEL_CODECS = ('rowlz', 'rle')
+# zlib levels tried for the deflate codecs.
+LEVELS = (1, 6, 9)
+# tinfl's window is 32KB, so no dictionary can be bigger.
+MAX_DICTIONARY = 32768
+
+# Decode costs on the RP2040 in clk_sys cycles, per byte decoded and per
+# byte of input, for weighing codecs against --decode-budget. inflate_bench
+# measures them: flashed to a device at 125MHz, it prints this dict, fitted
+# by least squares to each codec's band decode times with the firmware's
+# default decoders. Paste its output here. The values below are estimates
+# made before it was run, in the ratios host/codec_bench measures.
+DECODE_CYCLES = {
+    'zlib': (24, 30),  # inflate, then Adler-32 over the output
+    'deflate': (20, 30),
+    'rowlz': (26, 34),
+    'rle': (4, 4),
+}
+FILTER_CYCLES = 8  # per stored byte, to undo filters
+UNPACK_CYCLES = 3  # per panel byte, to unpack packed3
+DICTIONARY_CYCLES = 1  # per dictionary byte per band, to prime the window
+
+# Reversible filters for zlib images, as the firmware's filter:: flags.
+# Each image gets whichever combination compresses it best.
+FILTER_REMAP = 1   # colours renumbered, most common first
+FILTER_PLANES = 2  # packed3 rows stored as three bit planes
+FILTER_UP = 4      # each row XORed with the row above it in its band
+FILTER_NAMES = [(FILTER_REMAP, 'remap'), (FILTER_PLANES, 'planes'),
+                (FILTER_UP, 'up')]
+
+
+# The colours in order of how often they appear, so the commonest gets
+# stored as 0. Returns the colour of each stored index.
+def frequency_order(pixels):
+    counts = collections.Counter(pixels)
+    return sorted(range(len(PALETTE)), key=lambda colour: -counts[colour])
+
+
+def xor_up(band, row_bytes):
+    result = bytearray(band[:row_bytes])
+    for top in range(row_bytes, len(band), row_bytes):
+        above = int.from_bytes(band[top - row_bytes:top], 'big')
+        row = int.from_bytes(band[top:top + row_bytes], 'big')
+        result += (row ^ above).to_bytes(row_bytes, 'big')
+    return bytes(result)
+
+
+# Splits an image into bands of `band_rows` rows, in `pixel_format`, with
+# `filters` applied. Each band is compressed on its own, so the firmware
+# can decode any band without the others. Returns the bands, the bytes in
+# each row and, with FILTER_REMAP, the colour of each stored index.
+def split_bands(converted, pixel_format, band_rows, filters=0):
+    pixels = converted.tobytes()
+    palette = None
+    if filters & FILTER_REMAP:
+        palette = frequency_order(pixels)
+        index = {colour: i for i, colour in enumerate(palette)}
+        pixels = pixels.translate(bytes(index.get(p, p) for p in range(256)))
+    if filters & FILTER_PLANES:
+        data = planes3_bytes(pixels)
+    else:
+        data = FORMATS[pixel_format][1](pixels)
+    row_bytes = len(data) // HEIGHT
+    bands = []
+    for top in range(0, HEIGHT, band_rows):
+        rows = min(band_rows, HEIGHT - top)
+        band = data[top * row_bytes:(top + rows) * row_bytes]
+        if filters & FILTER_UP:
+            band = xor_up(band, row_bytes)
+        bands.append(band)
+    return bands, row_bytes, palette
+
+
+def compress_band(band, codec, row_bytes, level=9, dictionary=None):
+    if codec == 'rowlz':
+        return row_lz.encode(band, row_bytes, len(band) // row_bytes)
+    if codec == 'rle':
+        return rle.encode(band)
+    if codec == 'deflate' or dictionary:
+        # Raw deflate: tinfl can't take a preset dictionary in a zlib stream.
+        extra = {'zdict': dictionary} if dictionary else {}
+        compressor = zlib.compressobj(level, zlib.DEFLATED, -15, 9,
+                                      zlib.Z_DEFAULT_STRATEGY, **extra)
+        return compressor.compress(band) + compressor.flush()
+    return zlib.compress(band, level)
+
+
+# The codecs auto tries. Not zlib: it's deflate's stream plus a header and
+# Adler-32, so always bigger and slower, and auto would never pick it.
+AUTO_CODECS = [name for name in CODECS if name != 'zlib']
+
+
+# The encodings to try for each image, as (codec, format, filters, level).
+def candidates(codec, pixel_format, filters):
+    result = []
+    for name in AUTO_CODECS if codec == 'auto' else [codec]:
+        if name in PANEL_CODECS:
+            result.append((name, 'nibble4', 0, 0))
+            continue
+        for chosen in range(8) if filters == 'auto' else [0]:
+            if chosen & FILTER_PLANES and pixel_format != 'packed3':
+                continue
+            for level in LEVELS:
+                result.append((name, pixel_format, chosen, level))
+    return result
+
+
+# Estimated cycles for the firmware to decode an image's bands.
+def decode_cycles(codec, pixel_format, filters, bands, blocks,
+                  dictionary_size=0):
+    per_byte, per_input = DECODE_CYCLES[codec]
+    stored = sum(map(len, bands))
+    cycles = per_byte * stored + per_input * sum(map(len, blocks))
+    if filters:
+        cycles += FILTER_CYCLES * stored
+    elif pixel_format == 'packed3':
+        cycles += UNPACK_CYCLES * WIDTH * HEIGHT // 2
+    return cycles + DICTIONARY_CYCLES * dictionary_size * len(bands)
+
+
+# Builds a preset dictionary from the segments whose short substrings turn
+# up in the most bands. The best go last, where deflate's matches are
+# nearest and so cheapest.
+def train_dictionary(samples, size, segment=128, dmer=6):
+    seen = collections.Counter()
+    for sample in samples:
+        seen.update({sample[i:i + dmer]
+                     for i in range(len(sample) - dmer + 1)})
+    scored = []
+    for sample in samples:
+        for start in range(0, len(sample) - segment + 1, segment):
+            piece = sample[start:start + segment]
+            score = sum(seen[piece[i:i + dmer]]
+                        for i in range(segment - dmer + 1))
+            scored.append((score, piece))
+    scored.sort(key=lambda entry: -entry[0])
+    chosen = []
+    for _, piece in scored:
+        if len(chosen) == size // segment:
+            break
+        if piece not in chosen:
+            chosen.append(piece)
+    return b''.join(reversed(chosen))
+
+
+def write_bytes(cpp_file, data):
+    num_on_line = 0
+    for byte in data:
+        cpp_file.write(f"0x{byte:02x}, ")
+        num_on_line += 1
+        if num_on_line > 12:
+            cpp_file.write("\n  ")
+            num_on_line = 0
+
+
+# The options that control how images are encoded, shared with
+# pack_store.py.
+def encoding_options(command):
+    options = [
+        click.option("--show/--no-show"),
+        click.option("--format", "pixel_format",
+                     type=click.Choice(list(FORMATS)), default="packed3",
+                     show_default=True,
+                     help="How pixels are stored before deflate "
+                          "compression."),
+        click.option("--codec", type=click.Choice(list(CODECS) + ["auto"]),
+                     default="auto", show_default=True,
+                     help="Codec for every image, or auto to try all but zlib "
+                          "and keep the smallest within the decode budget."),
+        click.option("--decode-budget", type=click.FloatRange(0), default=0,
+                     show_default=True,
+                     help="Most milliseconds an image may take to decode, "
+                          "by DECODE_CYCLES' estimate; 0 for no limit."),
+        click.option("--clock-mhz", type=click.FloatRange(1), default=125,
+                     show_default=True,
+                     help="clk_sys the budget is measured at."),
+        click.option("--band-rows", type=click.IntRange(1, HEIGHT),
+                     default=56, show_default=True,
+                     help="Rows compressed together as one independent "
+                          "band."),
+        click.option("--dictionary-size",
+                     type=click.IntRange(0, MAX_DICTIONARY),
+                     default=MAX_DICTIONARY, show_default=True,
+                     help="Largest preset dictionary to train for deflate "
+                          "images; it is only used if it saves more than "
+                          "it costs."),
+        click.option("--force-dictionary", is_flag=True,
+                     help="Use the dictionary for every deflate image even "
+                          "where it costs more than it saves, as the "
+                          "benches do to exercise it."),
+        click.option("--filters", type=click.Choice(["auto", "none"]),
+                     default="auto", show_default=True,
+                     help="Whether to try reversible row filters on deflate "
+                          "images."),
+        click.option("--weight", "weights", multiple=True,
+                     metavar="NAME=WEIGHT",
+                     help="Times the image called NAME is shown per pass of "
+                          "the playlist, 0 for never; the rest get 1. May "
+                          "be repeated."),
+    ]
+    for option in reversed(options):
+        command = option(command)
+    return command
+
+
+# Converts and encodes `files`. Returns each image's encoding, as a dict of
+# the chosen candidate's fields plus its bands, palette, compressed blocks
+# and estimated decode cycles, and the preset dictionary (b'' for none).
+def encode_images(files, show, pixel_format, codec, decode_budget, clock_mhz,
+                  band_rows, dictionary_size, filters, weights=(),
+                  force_dictionary=False):
+    budget = decode_budget * clock_mhz * 1000 or float('inf')
+    image_weights = {}
+    for weight in weights:
+        name, _, value = weight.rpartition('=')
+        if not name or not value.isdigit() or int(value) > 255:
+            raise click.BadParameter(f"{weight} isn't NAME=WEIGHT, with a "
+                                     f"weight up to 255", param_hint="--weight")
+        image_weights[name] = int(value)
+    tried = candidates(codec, pixel_format, filters)
+    chosen = []
+    for image in files:
+        converted, portrait = convert(image)
+        if show:
+            converted.show()
+        encodings = []
+        for name, fmt, flags, level in tried:
+            bands, row_bytes, palette = split_bands(converted, fmt,
+                                                    band_rows, flags)
+            blocks = [compress_band(band, name, row_bytes, level)
+                      for band in bands]
+            encodings.append(dict(
+                image=image, portrait=portrait, codec=name, format=fmt,
+                filters=flags, level=level, bands=bands, row_bytes=row_bytes,
+                palette=palette, blocks=blocks, dictionary=False,
+                cycles=decode_cycles(name, fmt, flags, bands, blocks)))
+        size = lambda encoding: sum(map(len, encoding['blocks']))
+        if len(tried) > 1:
+            smallest = {}
+            for encoding in sorted(encodings, key=size, reverse=True):
+                smallest[encoding['codec']] = encoding
+            print(f"{image}: " + ', '.join(
+                f"{name} {size(smallest[name])} bytes "
+                f"{smallest[name]['cycles'] / clock_mhz / 1000:.1f}ms"
+                for name in CODECS if name in smallest))
+        fits = [encoding for encoding in encodings
+                if encoding['cycles'] <= budget]
+        if fits:
+            best = min(fits, key=size)
+        else:
+            best = min(encodings, key=lambda encoding: encoding['cycles'])
+            print(f"{image}: nothing decodes within the budget, so using "
+                  f"the fastest")
+        names = [name for flag, name in FILTER_NAMES
+                 if best['filters'] & flag]
+        fmt = '' if best['codec'] in PANEL_CODECS else ' ' + best['format']
+        print(f"{image}: {best['codec']}{fmt}"
+              f"{' level ' + str(best['level']) if best['level'] else ''}"
+              f"{', filters ' + ', '.join(names) if names else ''}: "
+              f"{size(best)} bytes, about "
+              f"{best['cycles'] / clock_mhz / 1000:.1f}ms to decode")
+        chosen.append(best)
+
+    # A preset dictionary shared by the deflate images, if it saves more
+    # than it costs. Images it doesn't help, or that it takes over budget,
+    # go without.
+    dictionary = b''
+    deflated = [encoding for encoding in chosen
+                if encoding['codec'] not in PANEL_CODECS]
+    if deflated and dictionary_size:
+        trained = train_dictionary(
+            [band for encoding in deflated for band in encoding['bands']],
+            dictionary_size)
+        primed = []
+        saved = 0
+        for encoding in deflated:
+            blocks = [compress_band(band, 'deflate', encoding['row_bytes'],
+                                    encoding['level'], trained)
+                      for band in encoding['bands']]
+            cycles = decode_cycles('deflate', encoding['format'],
+                                   encoding['filters'], encoding['bands'],
+                                   blocks, len(trained))
+            before = sum(map(len, encoding['blocks']))
+            after = sum(map(len, blocks))
+            print(f"{encoding['image']} with the dictionary: {before} -> "
+                  f"{after} ({before - after} saved)")
+            if force_dictionary or after < before and cycles <= budget:
+                saved += before - after
+                primed.append((encoding, blocks, cycles))
+        if force_dictionary or saved > len(trained):
+            print(f"Using the {len(trained)} byte dictionary: saves "
+                  f"{saved - len(trained)} bytes overall")
+            dictionary = trained
+            for encoding, blocks, cycles in primed:
+                encoding.update(codec='deflate', blocks=blocks, cycles=cycles,
+                                dictionary=True)
+        else:
+            print(f"Not using the {len(trained)} byte dictionary: it only "
+                  f"saves {saved}")
+
+    for encoding in chosen:
+        encoding['compressed'] = b''.join(encoding['blocks'])
+        offsets = [0]
+        for block in encoding['blocks']:
+            offsets.append(offsets[-1] + len(block))
+        encoding.update(offsets=offsets, band_rows=band_rows,
+                        crc=zlib.crc32(encoding['compressed']),
+                        weight=image_weights.get(Path(encoding['image']).name,
+                                                 1))
+        print(f"{encoding['image']} compressed to "
+              f"{len(encoding['compressed'])} ("
+              f"{100 * len(encoding['compressed']) / (WIDTH * HEIGHT / 2):.1f}"
+              f"%)")
+    return chosen, dictionary
+
+
 @click.command()
 @click.option("--header", type=click.File('w'), required=True)
 @click.option("--cpp-file", type=click.File('w'), required=True)
-@click.option("--show/--no-show")
+@encoding_options
+@click.option("--table", default="Image::Images", show_default=True,
+              help="Name of the generated array of images.")
 @click.argument("files", type=click.Path(exists=True, dir_okay=False), nargs=-1)
-def main(header, cpp_file, files, show):
+def main(header, cpp_file, files, table, **options):
     num_images = len(files)
-    header.write(f"""#pragma once
-
-#include <cstdlib>
-#include <cstdint>
-    
-struct Image {{
-  const char *name; 
-  const uint8_t *compressed_data;
-  size_t compressed_size;
-  bool portrait;
-  static constexpr auto NumImages = {num_images};
-  static const Image Images[NumImages];
-}};
-""")
+    chosen, dictionary = encode_images(files, **options)
     cpp_file.write(f"""
 #include "{header.name}"
 
 """)
-    images = []
-    frame_ratio = WIDTH / HEIGHT
-    for index, image in enumerate(files):
-        im = ImageOps.exif_transpose(Image.open(image))
-        portrait = im.height > im.width
-        if portrait:
-            im = im.transpose(Image.ROTATE_90)
-        image_ratio = im.width / im.height
-        if image_ratio > frame_ratio:
-            # Wider, so scale to height, then cut the middle bit out.
-            scale_height = HEIGHT
-            scale_width = int(scale_height * image_ratio)
-        else:
-            scale_width = WIDTH
-            scale_height = int(scale_width / image_ratio)
-        im = im.resize((scale_width, scale_height))
-        if scale_width > WIDTH:
-            lhs = (scale_width / 2) - (WIDTH / 2)
-            rhs = lhs + WIDTH
-            im = im.crop((lhs, 0, rhs, HEIGHT))
-        elif scale_height > HEIGHT:
-            top = (scale_height / 2) - (HEIGHT / 2)
-            bot = top + HEIGHT
-            im = im.crop((0, top, WIDTH, bot))
-        palette_image = Image.new('P', im.size)
-        palette_image.putpalette(list(sum(PALETTE, ())) * 32)
-        palette_image.paste(im, (0, 0) + im.size)
-        converted = im.quantize(
-            colors=len(PALETTE),
-            palette=palette_image,
-            dither=Image.FLOYDSTEINBERG)
-        if show:
-            converted.show()
-        num_on_line = 0
-        image_data = image_bytes(converted)
-        compressed = zlib.compress(image_data, 9)
-        print(
-            f"{image} compressed to {len(compressed)} "
-            f"({100 * len(compressed) / (WIDTH * HEIGHT / 2):.1f}%)")
+    if dictionary:
+        cpp_file.write("static const uint8_t image_dictionary[] = {\n  ")
+        write_bytes(cpp_file, dictionary)
+        cpp_file.write("\n};\n")
 
+    for index, encoding in enumerate(chosen):
+        cpp_file.write(
+            f"static const uint32_t image_bands_{index}[] = {{ "
+            f"{', '.join(map(str, encoding['offsets']))} }};\n")
+        if encoding['palette']:
+            cpp_file.write(
+                f"static const uint8_t image_palette_{index}[] = {{ "
+                f"{', '.join(str(colour) for colour in encoding['palette'])}"
+                f" }};\n")
         cpp_file.write(f"static const uint8_t image_data_{index}[] = {{\n  ")
-        images.append((Path(image).name, len(compressed), portrait))
-        for byte in compressed:
-            cpp_file.write(f"0x{byte:02x}, ")
-            num_on_line += 1
-            if num_on_line > 12:
-                cpp_file.write("\n  ")
-                num_on_line = 0
+        write_bytes(cpp_file, encoding['compressed'])
         cpp_file.write("""
 };
 """)
 
-    cpp_file.write(f"""
+    # With no images (as when they're in the flash store instead) there's
+    # no table, as C++ has no empty arrays.
+    if chosen:
+        cpp_file.write(f"""
 
-const Image Image::Images[NumImages] = {{
+{"" if table == "Image::Images" else f"extern const Image {table}[];"}
+const Image {table}[Image::NumImages] = {{
 
 """)
 
-    for index, (image, size, portrait) in enumerate(images):
+    for index, encoding in enumerate(chosen):
+        compressed = encoding['compressed']
+        preset = (f"image_dictionary, {len(dictionary)}"
+                  if encoding['dictionary'] else "nullptr, 0")
+        palette = (f"image_palette_{index}" if encoding['palette']
+                   else "nullptr")
         cpp_file.write(
-            f'{{ "{image}", image_data_{index}, {size}, '
-            f'{"true" if portrait else "false"} }},\n')
+            f'{{ "{Path(encoding["image"]).name}", image_data_{index}, '
+            f'{len(compressed)}, 0x{encoding["crc"]:08x}, '
+            f'{"true" if encoding["portrait"] else "false"}, '
+            f'PixelFormat::{FORMATS[encoding["format"]][0]}, '
+            f'Codec::{CODECS[encoding["codec"]][0]}, {encoding["band_rows"]}, '
+            f'{len(encoding["blocks"])}, image_bands_{index}, {preset}, '
+            f'{encoding["filters"]}, {palette}, {encoding["weight"]} }},\n')
 
-    cpp_file.write("""
+    if chosen:
+        cpp_file.write("""
 };
     """)
 
+    used = {encoding['codec'] for encoding in chosen}
+    codecs = ''.join(
+        f"  {name},{' ' * (8 - len(name))}// {comment}\n" if comment
+        else f"  {name},\n" for name, comment in CODECS.values())
+    uses = ', '.join('true' if codec in used else 'false' for codec in CODECS)
+    table_declaration = ("  static const Image Images[NumImages];\n"
+                         if num_images else "")
+    landscape = [str(index) for index, encoding in enumerate(chosen)
+                 if not encoding['portrait']]
+    portrait = [str(index) for index, encoding in enumerate(chosen)
+                if encoding['portrait']]
+    landscape_indexes = ', '.join(landscape)
+    portrait_indexes = ', '.join(portrait)
+    header.write(f"""#pragma once
+
+#include <array>
+#include <cstdlib>
+#include <cstdint>
+
+enum class PixelFormat : uint8_t {{
+  Nibble4, // two pixels to a byte, as the panel takes them
+  Packed3, // eight 3-bit pixels to three bytes
+}};
+
+enum class Codec : uint8_t {{
+{codecs}}};
+constexpr size_t NumCodecs = {len(CODECS)};
+
+// Which codecs these images use, by Codec. The firmware only links decoders
+// for those (see decode.hpp).
+constexpr bool UsesCodec[NumCodecs] = {{ {uses} }};
+
+// Reversible filters applied to deflate images' rows before compression, as
+// flags. The firmware undoes them in one pass over each row (see filter.hpp).
+namespace filter {{
+constexpr uint8_t Remap = 1;  // colours renumbered; see Image::palette
+constexpr uint8_t Planes = 2; // Packed3 rows stored as three bit planes
+constexpr uint8_t Up = 4;     // rows XORed with the (stored) row above
+}} // namespace filter
+
+struct Image {{
+  const char *name; 
+  const uint8_t *compressed_data;
+  size_t compressed_size;
+  // CRC-32 of compressed_data, checked before an image is shown.
+  uint32_t crc;
+  bool portrait;
+  PixelFormat format; // of the decompressed data
+  Codec codec;
+  // Each band of `band_rows` rows (the last may be short) is compressed on
+  // its own, from compressed_data + band_offsets[i] to band_offsets[i + 1].
+  uint16_t band_rows;
+  uint16_t num_bands;
+  const uint32_t *band_offsets;
+  const uint8_t *dictionary;
+  uint16_t dictionary_size;
+  uint8_t filters;
+  // With filter::Remap, the colour of each stored index.
+  const uint8_t *palette;
+  // Times it's shown per pass of the playlist (see playlist.hpp), 0 for
+  // never.
+  uint8_t weight;
+  static constexpr size_t NumImages = {num_images};
+{table_declaration}
+  // Indexes into Images of the landscape and of the portrait images, each
+  // in order, so the next either way up is found without a scan.
+  static constexpr size_t NumLandscape = {len(landscape)};
+  static constexpr size_t NumPortrait = {len(portrait)};
+  static constexpr std::array<uint16_t, NumLandscape> Landscape = {{
+      {{{landscape_indexes}}}}};
+  static constexpr std::array<uint16_t, NumPortrait> Portrait = {{
+      {{{portrait_indexes}}}}};
+}};
+""")
+
 
 if __name__ == '__main__':
     main()
@@ -0,0 +1,151 @@
+# Packs images into the flash image store (see image_store.hpp), as a UF2
+# that writes just that region, so the photos can be changed without
+# rebuilding or reflashing the firmware. Takes conv.py's encoding options.
+from pathlib import Path
+import re
+import struct
+import zlib
+
+import click
+
+import conv
+
+
+# The `constexpr <type> <Name> = <literal>;` constants in the firmware's
+# image_store.hpp, so the store is packed as the firmware reads it.
+def firmware_constants():
+    header = Path(__file__).resolve().parent.parent / 'image_store.hpp'
+    return {name: int(value, 0) for name, value in re.findall(
+        r'constexpr \w+ (\w+) = (0x[0-9a-fA-F]+|\d+);', header.read_text())}
+
+
+FIRMWARE = firmware_constants()
+# Where the store goes in flash and the most it may take.
+OFFSET = FIRMWARE['Offset']
+SIZE = FIRMWARE['Size']
+MAGIC = FIRMWARE['Magic']
+VERSION = FIRMWARE['Version']
+NAME_BYTES = FIRMWARE['NameBytes']
+PALETTE_BYTES = FIRMWARE['PaletteBytes']
+MAX_IMAGES = FIRMWARE['MaxImages']
+HEADER = '<IIHHIIIII'
+ENTRY = f'<{NAME_BYTES}sIIIIIHHBBBBBB2x'
+
+XIP_BASE = 0x10000000
+UF2_MAGIC_START0 = 0x0A324655
+UF2_MAGIC_START1 = 0x9E5D5157
+UF2_MAGIC_END = 0x0AB16F30
+UF2_FLAG_FAMILY_ID = 0x2000
+RP2040_FAMILY_ID = 0xe48bff56
+UF2_PAYLOAD = 256
+
+
+def align(data, to=4):
+    return data + bytes(-len(data) % to)
+
+
+# The store holding `chosen` (from conv.encode_images) and `dictionary`.
+def pack(chosen, dictionary):
+    if len(chosen) > MAX_IMAGES:
+        raise click.ClickException(
+            f"{len(chosen)} images, but the firmware takes {MAX_IMAGES}")
+    entries_end = (struct.calcsize(HEADER) +
+                   len(chosen) * struct.calcsize(ENTRY))
+    # The band tables and palettes, which the index CRC covers, then the
+    # dictionary and data, which have CRCs of their own.
+    tables = bytearray()
+    data = bytearray()
+    placed = []
+    for encoding in chosen:
+        bands_offset = len(tables)
+        tables += struct.pack(f"<{len(encoding['offsets'])}I",
+                              *encoding['offsets'])
+        palette_offset = None
+        if encoding['palette']:
+            palette_offset = len(tables)
+            palette = bytes(encoding['palette'])
+            tables += align(palette + bytes(PALETTE_BYTES - len(palette)))
+        data_offset = len(data)
+        data += align(encoding['compressed'])
+        placed.append((bands_offset, palette_offset, data_offset))
+    index_size = entries_end + len(tables)
+    dictionary_offset = 0
+    if dictionary:
+        dictionary_offset = index_size + len(data)
+        data += align(dictionary)
+
+    entries = b''
+    for encoding, (bands_offset, palette_offset, data_offset) in zip(
+            chosen, placed):
+        name = Path(encoding['image']).name.encode()
+        if len(name) >= NAME_BYTES:
+            raise click.ClickException(
+                f"{encoding['image']}: the name is too long")
+        bands_offset += entries_end
+        palette_offset = (0 if palette_offset is None
+                          else entries_end + palette_offset)
+        data_offset += index_size
+        entries += struct.pack(
+            ENTRY, name, data_offset, len(encoding['compressed']),
+            encoding['crc'], bands_offset, palette_offset,
+            encoding['band_rows'], len(encoding['blocks']),
+            encoding['portrait'], list(conv.FORMATS).index(encoding['format']),
+            list(conv.CODECS).index(encoding['codec']), encoding['filters'],
+            encoding['dictionary'], encoding['weight'])
+    # The index CRC covers the header from `version` on, the entries, then
+    # the band tables and palettes.
+    rest = struct.pack(HEADER, 0, 0, VERSION, len(chosen), index_size,
+                       index_size + len(data), dictionary_offset,
+                       len(dictionary), zlib.crc32(dictionary))[8:]
+    rest += entries + tables
+    return struct.pack('<II', MAGIC, zlib.crc32(rest)) + rest + data
+
+
+def uf2(data, address):
+    data = data + bytes(-len(data) % UF2_PAYLOAD)
+    count = len(data) // UF2_PAYLOAD
+    blocks = b''
+    for number in range(count):
+        payload = data[number * UF2_PAYLOAD:(number + 1) * UF2_PAYLOAD]
+        blocks += struct.pack(
+            '<8I', UF2_MAGIC_START0, UF2_MAGIC_START1, UF2_FLAG_FAMILY_ID,
+            address + number * UF2_PAYLOAD, UF2_PAYLOAD, number, count,
+            RP2040_FAMILY_ID)
+        blocks += payload + bytes(476 - UF2_PAYLOAD)
+        blocks += struct.pack('<I', UF2_MAGIC_END)
+    return blocks
+
+
+def image_files(paths):
+    for path in map(Path, paths):
+        if path.is_dir():
+            yield from sorted(
+                str(file) for file in path.iterdir()
+                if file.suffix.lower() in ('.jpg', '.jpeg', '.png'))
+        else:
+            yield str(path)
+
+
+@click.command()
+@click.option("--output", type=click.File('wb'),
+              help="The UF2 to write.")
+@click.option("--bin", "bin_file", type=click.File('wb'),
+              help="Also write the raw store, as the host benches read it.")
+@conv.encoding_options
+@click.argument("paths", type=click.Path(exists=True), nargs=-1)
+def main(output, bin_file, paths, **options):
+    files = list(image_files(paths))
+    chosen, dictionary = conv.encode_images(files, **options)
+    store = pack(chosen, dictionary)
+    if len(store) > SIZE:
+        raise click.ClickException(
+            f"{len(store)} bytes of images don't fit in {SIZE:#x}")
+    print(f"{len(chosen)} images packed into {len(store)} bytes")
+    if output:
+        output.write(uf2(store, XIP_BASE + OFFSET))
+    if bin_file:
+        bin_file.write(store)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,44 @@
+"""Encoder for the run-length codec, decoded by rle.cpp.
+
+Dithering leaves few long runs, so this rarely compresses as well as deflate
+or row LZ, but it decodes at little more than memcpy speed with no tables
+and no window, which can make it the one to pick under a tight decode-time
+budget. It works on the panel's bytes, two pixels each.
+
+A stream is a sequence of packets, each a control byte and then:
+
+  0x00..0x7f  control + 1 literal bytes
+  0x80..0xff  one byte, repeated (control & 0x7f) + MIN_RUN times
+"""
+
+MIN_RUN = 3
+MAX_RUN = 0x7f + MIN_RUN
+MAX_LITERALS = 0x80
+
+
+def encode(data: bytes) -> bytes:
+    result = bytearray()
+    literals = bytearray()
+
+    def flush():
+        for start in range(0, len(literals), MAX_LITERALS):
+            piece = literals[start:start + MAX_LITERALS]
+            result.append(len(piece) - 1)
+            result.extend(piece)
+        literals.clear()
+
+    i = 0
+    while i < len(data):
+        run = 1
+        while (i + run < len(data) and run < MAX_RUN and
+               data[i + run] == data[i]):
+            run += 1
+        if run >= MIN_RUN:
+            flush()
+            result += bytes((0x80 | (run - MIN_RUN), data[i]))
+            i += run
+        else:
+            literals.append(data[i])
+            i += 1
+    flush()
+    return bytes(result)
@@ -0,0 +1,122 @@
+"""Encoder for the "row LZ" codec, decoded by row_lz.cpp.
+
+Dithered frames have few long repeats but lots of short ones, nearly all
+against something close by: the dither pattern to the left, or the rows
+above. So this is LZ77 with the copy distances restricted to a handful of
+neighbours, which keeps decoding to the current and two previous rows, and a
+single Huffman table over literals and (neighbour, length) copies. It works
+on the panel's bytes, two pixels each, so the decoder's output goes straight
+to the panel.
+
+A stream is the code lengths for every symbol, four bits each with the even
+symbol in the high nibble, followed by the codes, MSB first. Symbols are:
+
+  0..63    a literal byte (both pixels' 3-bit colours)
+  64..319  a copy of 1..MAX_RUN bytes from one of NEIGHBOURS, as
+           64 + neighbour * MAX_RUN + length - 1
+
+Copies never run past the end of a row. Bytes off the left or right edge of
+a row, or above the top of the image, read as 0.
+"""
+
+import collections
+import heapq
+from typing import Dict, List, Sequence
+
+NUM_LITERALS = 64
+MAX_RUN = 32
+# (dx, dy) of the byte each copy reads from.
+NEIGHBOURS = [(-1, 0), (-2, 0), (0, -1), (1, -1),
+              (-1, -1), (0, -2), (-1, -2), (1, -2)]
+NUM_SYMBOLS = NUM_LITERALS + len(NEIGHBOURS) * MAX_RUN
+MAX_CODE_BITS = 11
+
+
+def _tokens(data: bytes, width: int, height: int) -> List[int]:
+    symbols = []
+    blank = bytes(width)
+    for y in range(height):
+        row = data[y * width:(y + 1) * width]
+        rows = [row,
+                data[(y - 1) * width:y * width] if y >= 1 else blank,
+                data[(y - 2) * width:(y - 1) * width] if y >= 2 else blank]
+        x = 0
+        while x < width:
+            best_run, best = 0, 0
+            limit = min(MAX_RUN, width - x)
+            for index, (dx, dy) in enumerate(NEIGHBOURS):
+                source = rows[-dy]
+                run = 0
+                while run < limit:
+                    sx = x + run + dx
+                    p = source[sx] if 0 <= sx < width else 0
+                    if row[x + run] != p:
+                        break
+                    run += 1
+                if run > best_run:
+                    best_run, best = run, index
+            if best_run:
+                symbols.append(NUM_LITERALS + best * MAX_RUN + best_run - 1)
+                x += best_run
+            else:
+                symbols.append(((row[x] >> 1) & 0x38) | (row[x] & 7))
+                x += 1
+    return symbols
+
+
+def _code_lengths(freq: Dict[int, int]) -> Dict[int, int]:
+    """Huffman code lengths, squashing the counts until none is longer than
+    MAX_CODE_BITS."""
+    if len(freq) == 1:
+        return {symbol: 1 for symbol in freq}
+    while True:
+        heap = [(count, symbol, [symbol]) for symbol, count in freq.items()]
+        heapq.heapify(heap)
+        depth: Dict[int, int] = collections.Counter()
+        tiebreak = NUM_SYMBOLS
+        while len(heap) > 1:
+            a = heapq.heappop(heap)
+            b = heapq.heappop(heap)
+            for symbol in a[2] + b[2]:
+                depth[symbol] += 1
+            tiebreak += 1
+            heapq.heappush(heap, (a[0] + b[0], tiebreak, a[2] + b[2]))
+        if max(depth.values()) <= MAX_CODE_BITS:
+            return depth
+        freq = {symbol: (count + 1) // 2 for symbol, count in freq.items()}
+
+
+def _canonical_codes(lengths: Sequence[int]) -> List[int]:
+    codes = [0] * len(lengths)
+    code = 0
+    for length in range(1, MAX_CODE_BITS + 1):
+        for symbol, symbol_length in enumerate(lengths):
+            if symbol_length == length:
+                codes[symbol] = code
+                code += 1
+        code <<= 1
+    return codes
+
+
+def encode(data: bytes, width: int, height: int) -> bytes:
+    """Compresses a frame in the panel's layout, `width` bytes a row."""
+    symbols = _tokens(data, width, height)
+    freq = collections.Counter(symbols)
+    found = _code_lengths(freq)
+    lengths = [found.get(symbol, 0) for symbol in range(NUM_SYMBOLS)]
+    codes = _canonical_codes(lengths)
+
+    result = bytearray()
+    for symbol in range(0, NUM_SYMBOLS, 2):
+        result.append((lengths[symbol] << 4) | lengths[symbol + 1])
+    acc, num_bits = 0, 0
+    for symbol in symbols:
+        acc = (acc << lengths[symbol]) | codes[symbol]
+        num_bits += lengths[symbol]
+        while num_bits >= 8:
+            num_bits -= 8
+            result.append((acc >> num_bits) & 0xff)
+        acc &= (1 << num_bits) - 1
+    if num_bits:
+        result.append((acc << (8 - num_bits)) & 0xff)
+    return bytes(result)
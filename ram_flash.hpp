@@ -0,0 +1,50 @@
+#pragma once
+
+#include "flash_area.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Linux stand-in for DeviceFlash: RAM that keeps to NOR flash's rules, so
+// host-side code that writes state can be checked against them, including
+// what a reset part way through a write leaves behind.
+class RamFlash final : public FlashArea {
+public:
+  explicit RamFlash(size_t size) : bytes_(size, 0xff) {}
+
+  [[nodiscard]] size_t size() const override { return bytes_.size(); }
+  [[nodiscard]] const uint8_t *data() const override { return bytes_.data(); }
+  void erase(size_t offset) override {
+    offset -= offset % SectorBytes;
+    // Erased from the end, so a cut leaves the sector's header as it was.
+    for (size_t i = SectorBytes; i > 0 && powered(); --i) {
+      bytes_[offset + i - 1] = 0xff;
+      --budget_;
+    }
+    ++erases_;
+  }
+  void program(size_t offset, const uint8_t *data, size_t size) override {
+    for (size_t i = 0; i < size && powered(); ++i) {
+      // The byte the power goes during gets only some of its bits.
+      bytes_[offset + i] &= budget_ == 1 ? data[i] | 0x5a : data[i];
+      --budget_;
+    }
+  }
+
+  // Cuts the power after `bytes` more are erased or programmed, after which
+  // nothing changes until it's restored.
+  void cut_power_after(size_t bytes) { budget_ = bytes; }
+  void restore_power() { budget_ = std::numeric_limits<size_t>::max(); }
+  [[nodiscard]] bool powered() const { return budget_ != 0; }
+
+  // Sectors erased so far.
+  [[nodiscard]] size_t erases() const { return erases_; }
+
+private:
+  std::vector<uint8_t> bytes_;
+  size_t erases_ = 0;
+  size_t budget_ = std::numeric_limits<size_t>::max();
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "transport.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Linux stand-in for the panel: records every transaction so host-side code
+// can be checked byte-for-byte, and keeps count of how many bytes moved and
+// how long moving them took.
+class RecordingTransport final : public Transport {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // One chip select's worth: an optional command byte, then data.
+  struct Transaction {
+    bool has_command;
+    uint8_t command;
+    std::vector<uint8_t> data;
+  };
+
+  using Transport::command;
+  void command(uint8_t command, const uint8_t *params,
+               size_t length) override {
+    auto start = Clock::now();
+    transactions_.push_back({true, command, {params, params + length}});
+    account(1 + length, start);
+  }
+  void start_data(const uint8_t *data, size_t length) override {
+    auto start = Clock::now();
+    auto &bytes = data_transaction();
+    bytes.insert(bytes.end(), data, data + length);
+    account(length, start);
+  }
+  void start_fill(uint8_t value, size_t length) override {
+    auto start = Clock::now();
+    auto &bytes = data_transaction();
+    bytes.insert(bytes.end(), length, value);
+    account(length, start);
+  }
+  void open_data() override {
+    transactions_.push_back({false, 0, {}});
+    open_ = true;
+  }
+  void close_data() override { open_ = false; }
+  [[nodiscard]] bool busy() const override { return false; }
+  void wait() override {}
+
+  [[nodiscard]] const std::vector<Transaction> &transactions() const {
+    return transactions_;
+  }
+  [[nodiscard]] size_t bytes_moved() const { return bytes_moved_; }
+  // Host time spent inside the transport.
+  [[nodiscard]] Clock::duration time_taken() const { return time_taken_; }
+  // How long the same bytes would spend on an SPI bus running at `baud`.
+  [[nodiscard]] std::chrono::nanoseconds wire_time(uint32_t baud) const {
+    return std::chrono::nanoseconds(bytes_moved_ * 8 * 1'000'000'000ull /
+                                    baud);
+  }
+  void reset() {
+    transactions_.clear();
+    bytes_moved_ = 0;
+    time_taken_ = {};
+  }
+
+private:
+  std::vector<uint8_t> &data_transaction() {
+    if (!open_)
+      transactions_.push_back({false, 0, {}});
+    return transactions_.back().data;
+  }
+  void account(size_t length, Clock::time_point start) {
+    bytes_moved_ += length;
+    time_taken_ += Clock::now() - start;
+  }
+
+  std::vector<Transaction> transactions_;
+  bool open_ = false;
+  size_t bytes_moved_ = 0;
+  Clock::duration time_taken_{};
+};
@@ -0,0 +1,69 @@
+#include "rle.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void RleDecoder::start(const uint8_t *compressed, size_t size) {
+  in_ = compressed;
+  end_ = compressed + size;
+  left_ = 0;
+  run_ = false;
+}
+
+bool RleDecoder::fill(uint8_t *out, size_t length) {
+  while (length) {
+    if (!left_) {
+      if (in_ == end_)
+        return false;
+      const auto control = *in_++;
+      run_ = control & 0x80;
+      if (run_) {
+        if (in_ == end_)
+          return false;
+        left_ = (control & 0x7fu) + rle::MinRun;
+        value_ = *in_++;
+      } else {
+        left_ = control + 1u;
+      }
+    }
+    const auto piece = std::min(left_, length);
+    if (run_) {
+      std::memset(out, value_, piece);
+    } else {
+      if (piece > static_cast<size_t>(end_ - in_))
+        return false;
+      std::memcpy(out, in_, piece);
+      in_ += piece;
+    }
+    out += piece;
+    length -= piece;
+    left_ -= piece;
+  }
+  return true;
+}
+
+bool RleDecoder::decode(const uint8_t *compressed, size_t size, size_t rows,
+                        uint8_t *out) {
+  start(compressed, size);
+  return fill(out, rows * frame::RowBytes) && finished();
+}
+
+int32_t RleDecoder::decode(const uint8_t *compressed, size_t size,
+                           size_t rows, Transport &out) {
+  start(compressed, size);
+  int32_t total = 0;
+  for (size_t y = 0; y < rows; y += RowsPerSend) {
+    // start_data() waits out the previous send, which reads the other
+    // buffer, so this one is free.
+    auto &buffer = buffers_[(y / RowsPerSend) & 1];
+    const auto bytes = std::min(RowsPerSend, rows - y) * frame::RowBytes;
+    if (!fill(buffer.data(), bytes)) {
+      out.wait();
+      return -1;
+    }
+    out.start_data(buffer.data(), bytes);
+    total += static_cast<int32_t>(bytes);
+  }
+  out.wait();
+  return finished() ? total : -1;
+}
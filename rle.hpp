@@ -0,0 +1,51 @@
+#pragma once
+
+#include "frame.hpp"
+#include "transport.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// The run-length codec, written by py/rle.py: packets of a control byte,
+// then either control + 1 literal bytes (below 0x80) or one byte repeated
+// (control & 0x7f) + MinRun times. It works on the panel's nibble layout,
+// so there are no tables and no window: decoding is memcpy and memset.
+namespace rle {
+
+constexpr size_t MinRun = 3;
+
+} // namespace rle
+
+class RleDecoder {
+public:
+  // Decodes a stream of `rows` rows into `out`, frame::RowBytes a row in the
+  // nibble layout. Returns false if the stream is corrupt.
+  bool decode(const uint8_t *compressed, size_t size, size_t rows,
+              uint8_t *out);
+  // Decodes a stream of `rows` rows straight to a transport, a few rows at a
+  // time. Returns the number of bytes sent, or -1 if the stream is corrupt.
+  int32_t decode(const uint8_t *compressed, size_t size, size_t rows,
+                 Transport &out);
+
+private:
+  static constexpr size_t RowsPerSend = 4;
+
+  void start(const uint8_t *compressed, size_t size);
+  // Decodes the next `length` bytes, carrying a packet over from the last
+  // call if need be. Returns false if the stream runs out.
+  bool fill(uint8_t *out, size_t length);
+  // Whether the input was used up exactly.
+  [[nodiscard]] bool finished() const { return in_ == end_ && !left_; }
+
+  const uint8_t *in_ = nullptr;
+  const uint8_t *end_ = nullptr;
+  // Bytes still to come from the current packet: a run of `value_`, or
+  // literals.
+  size_t left_ = 0;
+  bool run_ = false;
+  uint8_t value_ = 0;
+
+  alignas(4) std::array<std::array<uint8_t, RowsPerSend * frame::RowBytes>,
+                        2> buffers_{};
+};
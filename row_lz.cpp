@@ -0,0 +1,166 @@
+#include "row_lz.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace row_lz;
+
+bool RowLzDecoder::start(const uint8_t *compressed, size_t size) {
+  if (size < HeaderBytes)
+    return false;
+  std::array<uint8_t, NumSymbols> lengths;
+  for (size_t i = 0; i < HeaderBytes; ++i) {
+    lengths[2 * i] = compressed[i] >> 4;
+    lengths[2 * i + 1] = compressed[i] & 15;
+  }
+
+  // Canonical codes, as deflate assigns them.
+  std::array<uint32_t, MaxCodeBits + 1> count{};
+  for (auto length : lengths) {
+    if (length > MaxCodeBits)
+      return false;
+    ++count[length];
+  }
+  count[0] = 0;
+  std::array<uint32_t, MaxCodeBits + 1> next{};
+  uint32_t code = 0;
+  uint32_t used = 0;
+  for (unsigned length = 1; length <= MaxCodeBits; ++length) {
+    code = (code + count[length - 1]) << 1;
+    next[length] = code;
+    used += count[length] << (MaxCodeBits - length);
+  }
+  if (used > table_.size())
+    return false;
+  table_.fill(0);
+  for (unsigned symbol = 0; symbol < NumSymbols; ++symbol) {
+    const auto length = lengths[symbol];
+    if (!length)
+      continue;
+    const auto shift = MaxCodeBits - length;
+    uint32_t entry = length;
+    if (symbol < NumLiterals) {
+      const auto byte = (symbol & 0x38) << 1 | (symbol & 7);
+      entry |= LiteralFlag | byte << LiteralShift | 1u << RunShift;
+    } else {
+      const auto copy = symbol - NumLiterals;
+      const auto neighbour = copy / MaxRun;
+      entry |= neighbour << NeighbourShift | (copy % MaxRun + 1) << RunShift;
+      if (neighbour >= 2)
+        entry |= UpFlag;
+    }
+    std::fill_n(table_.begin() + (next[length]++ << shift), 1u << shift,
+                entry);
+  }
+
+  for (auto &row : rows_)
+    row.fill(0);
+  current_ = 0;
+  reader_ = {compressed + HeaderBytes, compressed + size, 0, 0, 0};
+  return true;
+}
+
+bool RowLzDecoder::next_row(uint8_t *out) {
+  auto *row = rows_[current_].data() + Pad;
+  const auto *up = rows_[(current_ + 2) % 3].data() + Pad;
+  const auto *up2 = rows_[(current_ + 1) % 3].data() + Pad;
+  // Where each neighbour is for the byte at x = 0, in py/row_lz.py's order.
+  const uint8_t *const neighbours[NumNeighbours] = {
+      row - 1, row - 2, up, up + 1, up - 1, up2, up2 - 1, up2 + 1};
+
+  auto reader = reader_;
+  size_t x = 0;
+  // Decodes the next code, which must already be in `reader`.
+  const auto decode_code = [&] {
+    const uint32_t entry = table_[reader.peek()];
+    const auto length = entry & 15u;
+    if (!length)
+      return false;
+    reader.consume(length);
+    // Every code writes two words, which may overshoot what it decodes to:
+    // the next code writes over the excess, and the row's end is checked
+    // once, after it. Copies from the left repeat the byte or pair before
+    // them, so are a pattern like a literal's; copies from above are
+    // selected over the pattern without a branch.
+    const auto neighbour = entry >> NeighbourShift & (NumNeighbours - 1);
+    const auto *from = neighbours[neighbour] + x;
+    const uint32_t copied = (entry / LiteralFlag & 1) - 1u;
+    const uint32_t pair = ((from[0] | from[neighbour] << 8) & copied) |
+                          (entry >> LiteralShift & 0xff) * 0x101u;
+    const uint32_t pattern = pair * 0x10001u;
+    const uint32_t above = 0u - (entry / UpFlag & 1);
+    uint32_t words[2];
+    std::memcpy(words, from, 8);
+    words[0] = (words[0] & above) | (pattern & ~above);
+    words[1] = (words[1] & above) | (pattern & ~above);
+    auto *to = row + x;
+    std::memcpy(to, words, 8);
+    const size_t run = entry >> RunShift & 63u;
+    x += run;
+    // Only the odd long run needs more.
+    for (size_t done = 8; done < run; done += 4) {
+      if (entry & UpFlag)
+        std::memcpy(words, from + done, 4);
+      std::memcpy(to + done, words, 4);
+    }
+    return true;
+  };
+  // A refill leaves at least 24 bits, enough for two codes.
+  while (x < frame::RowBytes) {
+    reader.refill();
+    if (!decode_code())
+      return false;
+    if (x < frame::RowBytes && !decode_code())
+      return false;
+  }
+  if (x != frame::RowBytes || reader.overrun())
+    return false;
+  reader_ = reader;
+  // Anything written past the end must read as the zeros beyond it.
+  std::fill_n(row + frame::RowBytes, Slack, 0);
+
+  std::memcpy(out, row, frame::RowBytes);
+  current_ = (current_ + 1) % 3;
+  return true;
+}
+
+bool RowLzDecoder::finished() const {
+  // Only the final byte's padding bits may be left over.
+  const auto unread = 8 * static_cast<uint32_t>(reader_.end - reader_.in) +
+                      reader_.count - 8 * reader_.padding;
+  return unread < 8;
+}
+
+bool RowLzDecoder::decode(const uint8_t *compressed, size_t size,
+                          size_t rows, uint8_t *out) {
+  if (!start(compressed, size))
+    return false;
+  for (size_t y = 0; y < rows; ++y, out += frame::RowBytes) {
+    if (!next_row(out))
+      return false;
+  }
+  return finished();
+}
+
+int32_t RowLzDecoder::decode(const uint8_t *compressed, size_t size,
+                             size_t rows, Transport &out) {
+  if (!start(compressed, size))
+    return -1;
+  int32_t total = 0;
+  for (size_t y = 0; y < rows; y += RowsPerSend) {
+    // start_data() waits out the previous send, which reads the other
+    // buffer, so this one is free.
+    auto &buffer = buffers_[(y / RowsPerSend) & 1];
+    const auto batch = std::min(RowsPerSend, rows - y);
+    for (size_t i = 0; i < batch; ++i) {
+      if (!next_row(buffer.data() + i * frame::RowBytes)) {
+        out.wait();
+        return -1;
+      }
+    }
+    out.start_data(buffer.data(), batch * frame::RowBytes);
+    total += static_cast<int32_t>(batch * frame::RowBytes);
+  }
+  out.wait();
+  return finished() ? total : -1;
+}
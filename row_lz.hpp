@@ -0,0 +1,123 @@
+#pragma once
+
+#include "frame.hpp"
+#include "transport.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// The "row LZ" codec, written by py/row_lz.py. Dithered frames repeat in
+// short runs against nearby bytes, so it's LZ77 with copies only from a few
+// fixed neighbours in the current and previous two rows, and a single Huffman
+// table over literal bytes and (neighbour, length) copies. It works on the
+// panel's nibble layout, so decoded rows go straight out. A stream is the
+// code lengths, four bits per symbol, then the codes MSB first.
+namespace row_lz {
+
+constexpr unsigned NumLiterals = 64;
+constexpr unsigned MaxRun = 32;
+constexpr unsigned NumNeighbours = 8;
+constexpr unsigned NumSymbols = NumLiterals + NumNeighbours * MaxRun;
+constexpr unsigned MaxCodeBits = 11;
+constexpr size_t HeaderBytes = NumSymbols / 2;
+
+} // namespace row_lz
+
+// Decodes row LZ images a row at a time. Each token is one table lookup and
+// a short copy, and the state is the lookup table plus three rows, against
+// tinfl's 11KB decompressor and 32KB dictionary.
+class RowLzDecoder {
+public:
+  // Decodes a stream of `rows` rows into `out`, frame::RowBytes a row in the
+  // nibble layout. Returns false if the stream is corrupt.
+  bool decode(const uint8_t *compressed, size_t size, size_t rows,
+              uint8_t *out);
+  // Decodes a stream of `rows` rows straight to a transport, a few rows at a
+  // time. Returns the number of bytes sent, or -1 if the stream is corrupt.
+  int32_t decode(const uint8_t *compressed, size_t size, size_t rows,
+                 Transport &out);
+
+  // Reads the code table and rewinds to the top row. Returns false if the
+  // table is invalid.
+  bool start(const uint8_t *compressed, size_t size);
+  // Decodes the next row into `out`, frame::RowBytes in the nibble layout.
+  // Returns false if the stream is corrupt or runs out.
+  bool next_row(uint8_t *out);
+  // Whether the input was used up exactly, once every row is decoded.
+  [[nodiscard]] bool finished() const;
+
+private:
+  // Bytes either side of each row read as zero; the widest reach is two
+  // to the left and one to the right. Copies go a word at a time and may
+  // run up to a word past the end of a run, or a corrupt one past the end
+  // of the row, so the right has room for that too.
+  static constexpr size_t Pad = 2;
+  static constexpr size_t Slack = row_lz::MaxRun + 8;
+  static constexpr size_t RowSize = Pad + frame::RowBytes + Slack;
+  static constexpr size_t RowsPerSend = 4;
+
+  // Table entries: the code length in the low four bits, the neighbour
+  // copied from, the bytes the code decodes to, and for a literal its byte.
+  // UpFlag marks copies from the rows above, which don't overlap the row
+  // being written.
+  static constexpr unsigned NeighbourShift = 4;
+  static constexpr unsigned RunShift = 8;
+  static constexpr unsigned LiteralShift = 16;
+  static constexpr uint32_t UpFlag = 1u << 24;
+  static constexpr uint32_t LiteralFlag = 1u << 25;
+
+  // Reads codes MSB first. Decoding works on a local copy, as byte stores
+  // through uint8_t pointers would otherwise force members back to memory.
+  struct BitReader {
+    const uint8_t *in;
+    const uint8_t *end;
+    uint32_t bits;
+    uint32_t count;   // valid bits in `bits`
+    uint32_t padding; // zero bytes fed in past the end
+
+    // Tops `bits` up to at least 24 valid bits. Away from the end that's
+    // one big-endian word read and no branches on the count: the bytes
+    // that don't fit are read again next time, and OR in the same bits.
+    void refill() {
+      if (end - in >= 4) {
+        const uint32_t word = uint32_t{in[0]} << 24 | uint32_t{in[1]} << 16 |
+                              uint32_t{in[2]} << 8 | in[3];
+        bits |= word >> count;
+        in += (31 - count) >> 3;
+        count |= 24;
+        return;
+      }
+      while (count <= 24) {
+        uint32_t byte = 0;
+        if (in != end)
+          byte = *in++;
+        else
+          ++padding;
+        bits |= byte << (24 - count);
+        count += 8;
+      }
+    }
+    [[nodiscard]] uint32_t peek() const {
+      return bits >> (32 - row_lz::MaxCodeBits);
+    }
+    void consume(uint32_t length) {
+      bits <<= length;
+      count -= length;
+    }
+    // Whether any of the padding has been consumed.
+    [[nodiscard]] bool overrun() const { return padding * 8 > count; }
+  };
+
+  // Indexed by the next MaxCodeBits of input; a zero length is an unused
+  // code.
+  std::array<uint32_t, 1u << row_lz::MaxCodeBits> table_{};
+  // The current and previous two rows, in turn.
+  std::array<std::array<uint8_t, RowSize>, 3> rows_{};
+  size_t current_ = 0;
+
+  BitReader reader_{};
+
+  alignas(4) std::array<std::array<uint8_t, RowsPerSend * frame::RowBytes>,
+                        2> buffers_{};
+};
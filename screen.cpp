@@ -0,0 +1,243 @@
+#include "screen.hpp"
+
+#include "command_table.hpp"
+#include "debug.hpp"
+#include "pins.hpp"
+#include "timing.hpp"
+
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/stdlib.h" // NOLINT(modernize-deprecated-headers)
+
+namespace {
+
+constexpr auto InitSequence = command_table(
+    // App manual agrees
+    cmd(0x00, 0xef, 0x08),
+    // App manual says send 0x01 0x37 0x00 0x05 0x05.
+    cmd(0x01, 0x37, 0x00, 0x23, 0x23),
+    // App manual agrees
+    cmd(0x03, 0x00),
+    // App manual agrees
+    cmd(0x06, 0xc7, 0xc7, 0x1d),
+    // App manual says "flash frame rate" here for data
+    cmd(0x30, 0x3c),
+    // App manual says command 0x41 here, data 0
+    cmd(0x40, 0x00),
+    // App manual agrees
+    // This is "VCOM and Data interval settings"
+    // VBD[2:0] | DDX | CDI[3:0]
+    //          Vbd D CDI
+    //          | | | |  |
+    // 0x37 = 0b001 1 0111
+    // VBD of 001 is "white" (it's a colour, the "vertical back porch").
+    // DDX = 1 is LUT one "default" (b/w/g/b/r/y/o/X)
+    // CDI is "data interval", 7 is default of "10"
+    // timing diagram shows vsync/hsync timings, frame data is delayed by this
+    // many (hsyncs?) units.
+    cmd(0x50, 0x37),
+    // App manual agrees, though 0x60 is not listed in the data sheet.
+    cmd(0x60, 0x22),
+    // App manual agrees: this is setting the screen resolution.
+    cmd(0x61, high_byte(Screen::Width), low_byte(Screen::Width),
+        high_byte(Screen::Height), low_byte(Screen::Height)),
+    // App manual agrees
+    cmd(0xe3, 0xaa)
+    // App manual says 0x82 and "flash vcom".
+    // Datasheet says "Vcom_DC setting" and mentions voltages, from -0.1V down
+    // to -4V. VCOM is "common voltage" which is presumably the power to the
+    // screen? Referenced in many display docs, and is usually negative.
+);
+
+constexpr uint32_t BusyEdges = GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL;
+
+int64_t sev_callback(alarm_id_t, void *) {
+  __sev();
+  return 0;
+}
+
+} // namespace
+
+Screen::Screen(Transport &transport) : transport_(transport) {
+  // Reset select is active-low, so we'll initialise it to a driven-high state
+  gpio_init(Pins::Reset);
+  gpio_set_dir(Pins::Reset, GPIO_OUT);
+  gpio_put(Pins::Reset, true);
+
+  gpio_init(Pins::Busy);
+  gpio_set_dir(Pins::Busy, GPIO_IN);
+  // A raw handler keeps BUSY away from the orientation callback in main.
+  gpio_add_raw_irq_handler(Pins::Busy, busy_irq_handler);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void Screen::busy_irq_handler() {
+  if (gpio_get_irq_event_mask(Pins::Busy) & BusyEdges) {
+    gpio_acknowledge_irq(Pins::Busy, BusyEdges);
+    __sev();
+  }
+}
+
+bool Screen::wait_busy(bool level) {
+  // unlikely to be needed (seen blank screen issues)
+  timing::delay_ns<60>();
+  const auto start = get_absolute_time();
+  const auto deadline = delayed_by_ms(start, BusyTimeoutMs);
+  auto alarm_id = add_alarm_at(deadline, sev_callback, nullptr, false);
+  // Any edge (or the alarm) sets the event flag, so a change between reading
+  // the pin and the __wfe() still wakes us.
+  gpio_set_irq_enabled(Pins::Busy, BusyEdges, true);
+  bool reached;
+  while (!(reached = gpio_get(Pins::Busy) == level) && !time_reached(deadline))
+    __wfe();
+  gpio_set_irq_enabled(Pins::Busy, BusyEdges, false);
+  if (alarm_id > 0)
+    cancel_alarm(alarm_id);
+  last_busy_wait_us_ = static_cast<uint32_t>(
+      absolute_time_diff_us(start, get_absolute_time()));
+  if (!reached) {
+    ++busy_timeouts_;
+    debug("Timed out waiting for busy %s", level ? "high" : "low");
+  }
+  // unlikely to be needed (seen blank screen issues)
+  timing::delay_ns<60>();
+  return reached;
+}
+
+void Screen::reset() {
+  gpio_put(Pins::Reset, true);
+  sleep_ms(200);
+  gpio_put(Pins::Reset, false);
+  sleep_ms(2);
+  gpio_put(Pins::Reset, true);
+  busy_high();
+}
+
+void Screen::init() {
+  reset();
+  send_commands(InitSequence);
+}
+
+Screen::Operation Screen::start_clear(uint8_t colour) {
+  finish();
+  set_res();
+  send_command(0x10);
+  transport_.start_fill(colour | (colour << 4), FrameBytes);
+  return begin_refresh();
+}
+
+Screen::Operation Screen::start_image(const uint8_t *data) {
+  finish();
+  set_res();
+  send_command(0x10);
+  transport_.start_data(data, FrameBytes);
+  return begin_refresh();
+}
+
+Screen::Operation Screen::start_refresh() {
+  finish();
+  return begin_refresh();
+}
+
+void Screen::begin_upload() {
+  finish();
+  set_res();
+  send_command(0x10);
+  transport_.open_data();
+}
+
+Screen::Operation Screen::end_upload() {
+  transport_.close_data();
+  return begin_refresh();
+}
+
+void Screen::rainbow() {
+  finish();
+  set_res();
+  send_command(0x10);
+  for (auto band = 0; band < 8; ++band) {
+    send_repeated_data(band | (band << 4), FrameBytes / 8);
+  }
+  screen_refresh();
+}
+
+Screen::Operation Screen::begin_refresh() {
+  ++started_;
+  enter(Phase::Uploading, 0);
+  poll();
+  return {this, started_};
+}
+
+void Screen::enter(Phase phase, uint32_t timeout_ms) {
+  if (alarm_id_ > 0)
+    cancel_alarm(alarm_id_);
+  alarm_id_ = 0;
+  phase_ = phase;
+  phase_start_ = get_absolute_time();
+  const bool waits_on_busy = phase == Phase::PowerOn ||
+                             phase == Phase::Refreshing ||
+                             phase == Phase::PowerOff;
+  gpio_set_irq_enabled(Pins::Busy, BusyEdges, waits_on_busy);
+  if (waits_on_busy) {
+    // unlikely to be needed (seen blank screen issues)
+    timing::delay_ns<60>();
+  }
+  if (timeout_ms) {
+    phase_deadline_ = delayed_by_ms(phase_start_, timeout_ms);
+    alarm_id_ = add_alarm_at(phase_deadline_, sev_callback, nullptr, false);
+  }
+}
+
+bool Screen::busy_reached(bool level) {
+  const bool reached = gpio_get(Pins::Busy) == level;
+  if (!reached && !time_reached(phase_deadline_))
+    return false;
+  last_busy_wait_us_ = static_cast<uint32_t>(
+      absolute_time_diff_us(phase_start_, get_absolute_time()));
+  if (!reached) {
+    ++busy_timeouts_;
+    debug("Timed out waiting for busy %s", level ? "high" : "low");
+  }
+  return true;
+}
+
+void Screen::poll() {
+  for (;;) {
+    switch (phase_) {
+    case Phase::Idle:
+      return;
+    case Phase::Uploading:
+      if (transport_.busy())
+        return;
+      transport_.wait();
+      send_command(0x04);
+      enter(Phase::PowerOn, BusyTimeoutMs);
+      break;
+    case Phase::PowerOn:
+      if (!busy_reached(true))
+        return;
+      send_command(0x12);
+      enter(Phase::Refreshing, BusyTimeoutMs);
+      break;
+    case Phase::Refreshing:
+      if (!busy_reached(true))
+        return;
+      send_command(0x02);
+      enter(Phase::PowerOff, BusyTimeoutMs);
+      break;
+    case Phase::PowerOff:
+      if (!busy_reached(false))
+        return;
+      // TODO: have seen "blank image" without it BUT SRSLY can't be!
+      enter(Phase::Settling, 200);
+      break;
+    case Phase::Settling:
+      if (!time_reached(phase_deadline_))
+        return;
+      enter(Phase::Idle, 0);
+      finished_ = started_;
+      break;
+    }
+  }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "frame.hpp"
+#include "transport.hpp"
+
+#include "hardware/sync.h"
+#include "pico/stdlib.h" // NOLINT(modernize-deprecated-headers)
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+constexpr uint8_t low_byte(size_t value) { return value & 0xff; }
+constexpr uint8_t high_byte(size_t value) { return (value >> 8) & 0xff; }
+
+class Screen {
+  // Where an upload-and-refresh has got to; see `poll()`.
+  enum class Phase : uint8_t {
+    Idle,
+    Uploading,  // waiting for the transport to finish sending the frame
+    PowerOn,    // 0x04 sent, waiting for BUSY high
+    Refreshing, // 0x12 sent, waiting for BUSY high
+    PowerOff,   // 0x02 sent, waiting for BUSY low
+    Settling,   // the 200ms pause after power off
+  };
+
+  Transport &transport_;
+
+  template <typename... Args> void send_command(uint8_t command, Args... data) {
+    const std::array<uint8_t, sizeof...(Args)> params{
+        static_cast<uint8_t>(data)...};
+    transport_.command(command, params.data(), params.size());
+  }
+  // Replays a table built by `command_table()`.
+  template <size_t Size>
+  void send_commands(const std::array<uint8_t, Size> &table) {
+    transport_.commands(table.data(), table.size());
+  }
+  void send_repeated_data(uint8_t data, size_t length) {
+    transport_.fill(data, length);
+  }
+
+  // Sleeps until BUSY reads `level`, woken by its edge interrupt. Gives up
+  // after BusyTimeoutMs and returns false.
+  bool wait_busy(bool level);
+  bool busy_high() { return wait_busy(true); }
+  bool busy_low() { return wait_busy(false); }
+  static void busy_irq_handler();
+
+  void enter(Phase phase, uint32_t timeout_ms);
+  bool busy_reached(bool level);
+
+  Phase phase_ = Phase::Idle;
+  absolute_time_t phase_start_{};
+  absolute_time_t phase_deadline_{};
+  alarm_id_t alarm_id_ = 0;
+  uint32_t started_ = 0;
+  uint32_t finished_ = 0;
+  uint32_t last_busy_wait_us_ = 0;
+  uint32_t busy_timeouts_ = 0;
+
+public:
+  static constexpr auto Width = frame::Width;
+  static constexpr auto Height = frame::Height;
+  static constexpr size_t FrameBytes = frame::Bytes;
+  // A 7-colour refresh takes around 30s; this is well beyond that.
+  static constexpr uint32_t BusyTimeoutMs = 60'000;
+
+  // A started upload and refresh. Only one runs at a time: starting another
+  // waits for the current one first.
+  class Operation {
+    friend class Screen;
+    Screen *screen_;
+    uint32_t id_;
+    Operation(Screen *screen, uint32_t id) : screen_(screen), id_(id) {}
+
+  public:
+    // Advances the refresh as far as it can without blocking.
+    [[nodiscard]] bool done() const {
+      screen_->poll();
+      return static_cast<int32_t>(screen_->finished_ - id_) >= 0;
+    }
+    // Sleeps until the refresh is complete.
+    void wait() const {
+      while (!done())
+        __wfe();
+    }
+  };
+
+  explicit Screen(Transport &transport);
+
+  void reset();
+  void init();
+
+  // Non-blocking versions of clear(), image() and screen_refresh(). The
+  // returned Operation is driven along by `poll()`, which its `done()` and
+  // `wait()` call; the DMA, BUSY and timer interrupts just wake the core.
+  // `image()` data must stay untouched until the upload is done.
+  Operation start_clear(uint8_t colour);
+  Operation start_image(const uint8_t *data);
+  Operation start_refresh();
+  // Starts a frame upload that the caller feeds through `transport()` in as
+  // many pieces as it likes; they reach the panel as one 0x10 transaction.
+  // `end_upload()` then kicks off the refresh.
+  void begin_upload();
+  Operation end_upload();
+  // Ends an upload without refreshing, so the panel keeps showing what it
+  // was; the next upload overwrites whatever of the frame arrived.
+  void abort_upload() { transport_.close_data(); }
+  [[nodiscard]] Transport &transport() { return transport_; }
+  void poll();
+  [[nodiscard]] bool busy() const { return phase_ != Phase::Idle; }
+  // Waits for any in-flight operation.
+  void finish() { Operation(this, started_).wait(); }
+
+  void clear(uint8_t colour) { start_clear(colour).wait(); }
+  void rainbow();
+  void screen_refresh() { start_refresh().wait(); }
+  void set_res() {
+    // This is setting the screen resolution.
+    send_command(0x61, high_byte(Width), low_byte(Width), high_byte(Height),
+                 low_byte(Height));
+  }
+  // Uploads a whole 4bpp frame and refreshes.
+  void image(const uint8_t *data) { start_image(data).wait(); }
+  void sleep() {
+    finish();
+    send_command(0x07, 0xa5);
+  }
+
+  // How long the most recent BUSY wait took, timeouts included.
+  [[nodiscard]] uint32_t last_busy_wait_us() const {
+    return last_busy_wait_us_;
+  }
+  [[nodiscard]] uint32_t busy_timeouts() const { return busy_timeouts_; }
+
+private:
+  Operation begin_refresh();
+};
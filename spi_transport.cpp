@@ -0,0 +1,153 @@
+#include "spi_transport.hpp"
+
+#include "pins.hpp"
+#include "timing.hpp"
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/stdlib.h" // NOLINT(modernize-deprecated-headers)
+
+namespace {
+
+void cs_select() {
+  timing::delay_ns<20>();         // hold time
+  gpio_put(Pins::ChipSel, false); // Active low
+  timing::delay_ns<60>();         // setup time
+}
+
+void cs_deselect() {
+  timing::delay_ns<65>(); // hold time
+  gpio_put(Pins::ChipSel, true);
+  timing::delay_ns<40>(); // setup time
+}
+
+} // namespace
+
+SpiTransport::SpiTransport(spi_inst_t *spi, uint baud) : spi_(spi) {
+  spi_init(spi_, baud);
+  spi_set_format(spi_, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+  spi_set_slave(spi_, false);
+  gpio_set_function(Pins::Clock, GPIO_FUNC_SPI);
+  gpio_set_function(Pins::Mosi, GPIO_FUNC_SPI);
+
+  // Chip select is active-low, so we'll initialise it to a driven-high state
+  gpio_init(Pins::ChipSel);
+  gpio_set_dir(Pins::ChipSel, GPIO_OUT);
+  gpio_put(Pins::ChipSel, true);
+
+  gpio_init(Pins::Dc);
+  gpio_set_dir(Pins::Dc, GPIO_OUT);
+
+  // One byte per SPI TX DREQ, writing to the SPI data register. Data reads
+  // through the buffer; fills read the same byte over and over.
+  dma_channel_ = dma_claim_unused_channel(true);
+  data_config_ = dma_channel_get_default_config(dma_channel_);
+  channel_config_set_transfer_data_size(&data_config_, DMA_SIZE_8);
+  channel_config_set_dreq(&data_config_, spi_get_dreq(spi_, true));
+  channel_config_set_read_increment(&data_config_, true);
+  channel_config_set_write_increment(&data_config_, false);
+  fill_config_ = data_config_;
+  channel_config_set_read_increment(&fill_config_, false);
+  dma_channel_configure(dma_channel_, &data_config_, &spi_get_hw(spi_)->dr,
+                        nullptr, 0, false);
+
+  instance_ = this;
+  irq_set_exclusive_handler(DMA_IRQ_0, dma_irq_handler);
+  dma_channel_set_irq0_enabled(dma_channel_, true);
+  irq_set_enabled(DMA_IRQ_0, true);
+}
+
+SpiTransport::~SpiTransport() {
+  wait();
+  dma_channel_set_irq0_enabled(dma_channel_, false);
+  irq_set_enabled(DMA_IRQ_0, false);
+  dma_channel_unclaim(dma_channel_);
+  instance_ = nullptr;
+}
+
+void SpiTransport::dma_irq_handler() {
+  auto *self = instance_;
+  dma_channel_acknowledge_irq0(self->dma_channel_);
+  self->dma_running_ = false;
+  __sev();
+}
+
+void SpiTransport::command(uint8_t command, const uint8_t *params,
+                           size_t length) {
+  wait();
+  gpio_put(Pins::Dc, false);
+  cs_select();
+  // spi_write_blocking() waits for the shifter to go idle, so DC can change
+  // straight after it without corrupting the command byte.
+  spi_write_blocking(spi_, &command, 1);
+  if (length) {
+    gpio_put(Pins::Dc, true);
+    spi_write_blocking(spi_, params, length);
+  }
+  cs_deselect();
+}
+
+void SpiTransport::start_data(const uint8_t *data, size_t length) {
+  wait();
+  start_dma(data_config_, data, length);
+}
+
+void SpiTransport::start_fill(uint8_t value, size_t length) {
+  wait();
+  fill_value_ = value;
+  start_dma(fill_config_, &fill_value_, length);
+}
+
+void SpiTransport::open_data() {
+  wait();
+  gpio_put(Pins::Dc, true);
+  cs_select();
+  selected_ = true;
+  open_ = true;
+}
+
+void SpiTransport::close_data() {
+  open_ = false;
+  wait();
+}
+
+void SpiTransport::start_dma(const dma_channel_config &config,
+                             const uint8_t *data, size_t length) {
+  if (length == 0)
+    return;
+  if (!open_) {
+    gpio_put(Pins::Dc, true);
+    cs_select();
+    selected_ = true;
+  }
+  dma_running_ = true;
+  dma_channel_configure(dma_channel_, &config, &spi_get_hw(spi_)->dr, data,
+                        length, true);
+}
+
+bool SpiTransport::busy() const {
+  return dma_running_ || (selected_ && !open_ && spi_is_busy(spi_));
+}
+
+void SpiTransport::wait() {
+  while (dma_running_)
+    __wfe();
+  if (selected_ && !open_)
+    finish();
+}
+
+void SpiTransport::finish() {
+  // The DMA has only filled the FIFO; let the last bytes clock out before
+  // releasing chip select.
+  while (spi_is_busy(spi_))
+    tight_loop_contents();
+  // Nobody reads the RX side during a DMA write, so drain it and clear the
+  // overrun flag as spi_write_blocking() would.
+  while (spi_is_readable(spi_))
+    (void)spi_get_hw(spi_)->dr;
+  spi_get_hw(spi_)->icr = SPI_SSPICR_RORIC_BITS;
+  cs_deselect();
+  selected_ = false;
+}
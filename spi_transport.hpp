@@ -0,0 +1,44 @@
+#pragma once
+
+#include "transport.hpp"
+
+#include "hardware/dma.h"
+#include "hardware/spi.h"
+
+// Drives the panel from the hardware SPI block. Commands go out from the CPU;
+// data is streamed by a DMA channel paced by the SPI TX DREQ, with completion
+// signalled by the DMA interrupt so `wait()` can sleep in `__wfe()`.
+class SpiTransport final : public Transport {
+public:
+  SpiTransport(spi_inst_t *spi, uint baud);
+  ~SpiTransport() override;
+  SpiTransport(const SpiTransport &) = delete;
+  SpiTransport &operator=(const SpiTransport &) = delete;
+
+  using Transport::command;
+  void command(uint8_t command, const uint8_t *params,
+               size_t length) override;
+  void start_data(const uint8_t *data, size_t length) override;
+  void start_fill(uint8_t value, size_t length) override;
+  void open_data() override;
+  void close_data() override;
+  [[nodiscard]] bool busy() const override;
+  void wait() override;
+
+private:
+  static void dma_irq_handler();
+  void start_dma(const dma_channel_config &config, const uint8_t *data,
+                 size_t length);
+  void finish();
+
+  static inline SpiTransport *instance_ = nullptr;
+  spi_inst_t *spi_;
+  uint dma_channel_;
+  dma_channel_config data_config_;
+  dma_channel_config fill_config_;
+  // The DMA source for fills; read repeatedly without incrementing.
+  uint8_t fill_value_ = 0;
+  volatile bool dma_running_ = false;
+  bool selected_ = false;
+  bool open_ = false;
+};
@@ -0,0 +1,187 @@
+#include "state_log.hpp"
+
+#include "crc.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// A value's record, padded to keep the next aligned.
+constexpr size_t record_bytes(size_t header_bytes, size_t size) {
+  return header_bytes + (size + 3) / 4 * 4;
+}
+
+bool erased(const uint8_t *begin, const uint8_t *end) {
+  return std::all_of(begin, end, [](uint8_t byte) { return byte == 0xff; });
+}
+
+} // namespace
+
+// A record as it's laid out in flash, for checking and writing.
+struct StateLog::Record {
+  RecordHeader header;
+  uint8_t value[MaxValueBytes];
+
+  [[nodiscard]] const uint8_t *bytes() const {
+    return reinterpret_cast<const uint8_t *>(this);
+  }
+  [[nodiscard]] size_t size() const {
+    return sizeof(header) + header.size;
+  }
+  [[nodiscard]] uint32_t crc() const {
+    auto unchecked = *this;
+    unchecked.header.crc = 0;
+    return blob_crc32(unchecked.bytes(), size());
+  }
+};
+
+StateLog::StateLog(FlashArea &flash)
+    : flash_(flash), sectors_(flash.size() / FlashArea::SectorBytes) {
+  static_assert(sizeof(SectorHeader) +
+                        MaxKeys * record_bytes(sizeof(RecordHeader),
+                                               MaxValueBytes) <=
+                    FlashArea::SectorBytes,
+                "a sector can't hold every value");
+  bool found = false;
+  for (size_t index = 0; index < sectors_; ++index) {
+    SectorHeader header;
+    std::memcpy(&header, sector(index), sizeof(header));
+    if (header.magic != Magic || header.check != ~header.sequence)
+      continue;
+    // Sequence numbers are compared as serial numbers, so could wrap.
+    if (!found || static_cast<int32_t>(header.sequence - sequence_) > 0) {
+      found = true;
+      current_ = index;
+      sequence_ = header.sequence;
+    }
+  }
+  if (found) {
+    replay();
+  } else {
+    // Nothing's been saved; the first flush starts on sector 0.
+    current_ = sectors_ - 1;
+  }
+}
+
+void StateLog::replay() {
+  const auto *begin = sector(current_);
+  const auto *end = begin + FlashArea::SectorBytes;
+  size_t offset = sizeof(SectorHeader);
+  while (offset + sizeof(RecordHeader) <= FlashArea::SectorBytes) {
+    Record record;
+    std::memcpy(&record.header, begin + offset, sizeof(record.header));
+    if (erased(begin + offset, begin + offset + sizeof(record.header))) {
+      // The end of the log, unless a reset left part of a record after it
+      // that the next one would be programmed over.
+      if (erased(begin + offset, end))
+        end_ = offset;
+      return;
+    }
+    const auto bytes = record_bytes(sizeof(record.header), record.header.size);
+    if (record.header.size > MaxValueBytes ||
+        offset + bytes > FlashArea::SectorBytes)
+      break;
+    std::memcpy(record.value, begin + offset + sizeof(record.header),
+                record.header.size);
+    if (record.crc() != record.header.crc)
+      break;
+    if (auto *value = find(record.header.key)) {
+      value->size = record.header.size;
+      std::memcpy(value->bytes.data(), record.value, value->size);
+    } else if (num_values_ < MaxKeys) {
+      auto &added = values_[num_values_++];
+      added.key = record.header.key;
+      added.size = record.header.size;
+      std::memcpy(added.bytes.data(), record.value, added.size);
+    }
+    offset += bytes;
+  }
+  // Full, or a reset tore a record: nothing more goes in this sector, and
+  // the next flush starts another.
+}
+
+StateLog::Value *StateLog::find(uint16_t key) {
+  const auto *found = std::as_const(*this).find(key);
+  return const_cast<Value *>(found);
+}
+
+const StateLog::Value *StateLog::find(uint16_t key) const {
+  const auto *end = values_.data() + num_values_;
+  const auto *found = std::find_if(values_.data(), end, [key](const Value &v) {
+    return v.key == key;
+  });
+  return found == end ? nullptr : found;
+}
+
+bool StateLog::get(uint16_t key, void *value, size_t size) const {
+  const auto *found = find(key);
+  if (!found || found->size != size)
+    return false;
+  std::memcpy(value, found->bytes.data(), size);
+  return true;
+}
+
+bool StateLog::set(uint16_t key, const void *value, size_t size) {
+  if (key == Erased || size > MaxValueBytes)
+    return false;
+  auto *found = find(key);
+  if (!found) {
+    if (num_values_ == MaxKeys)
+      return false;
+    found = &values_[num_values_++];
+    found->key = key;
+  } else if (found->size == size &&
+             std::memcmp(found->bytes.data(), value, size) == 0) {
+    return true;
+  }
+  found->size = static_cast<uint16_t>(size);
+  std::memcpy(found->bytes.data(), value, size);
+  found->dirty = true;
+  dirty_ = true;
+  return true;
+}
+
+void StateLog::flush() {
+  if (!dirty_)
+    return;
+  size_t bytes = 0;
+  for (size_t index = 0; index < num_values_; ++index) {
+    if (values_[index].dirty)
+      bytes += record_bytes(sizeof(RecordHeader), values_[index].size);
+  }
+  if (end_ + bytes > FlashArea::SectorBytes) {
+    rotate();
+  } else {
+    for (size_t index = 0; index < num_values_; ++index) {
+      if (values_[index].dirty)
+        append(values_[index]);
+    }
+  }
+  for (size_t index = 0; index < num_values_; ++index)
+    values_[index].dirty = false;
+  dirty_ = false;
+}
+
+void StateLog::append(const Value &value) {
+  Record record{{value.key, value.size, 0}, {}};
+  std::memcpy(record.value, value.bytes.data(), value.size);
+  record.header.crc = record.crc();
+  flash_.program(current_ * FlashArea::SectorBytes + end_, record.bytes(),
+                 record.size());
+  end_ += record_bytes(sizeof(record.header), value.size);
+}
+
+void StateLog::rotate() {
+  current_ = (current_ + 1) % sectors_;
+  flash_.erase(current_ * FlashArea::SectorBytes);
+  end_ = sizeof(SectorHeader);
+  for (size_t index = 0; index < num_values_; ++index)
+    append(values_[index]);
+  // Only now that it holds everything does the header make it the newest.
+  ++sequence_;
+  const SectorHeader header{Magic, sequence_, ~sequence_};
+  flash_.program(current_ * FlashArea::SectorBytes,
+                 reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+}
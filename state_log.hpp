@@ -0,0 +1,100 @@
+#pragma once
+
+#include "flash_area.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Small values that outlive a reset, kept by key in `flash` as an
+// append-only log. set() only changes the copy in RAM; flush() appends a
+// record for each key that's changed since, so several changes cost one
+// write, which the caller times for when nothing else is using flash.
+//
+// Each sector starts with a copy of every value, so only the newest sector
+// is ever read. When it fills the log moves to the next sector round,
+// erasing it and copying the values there before marking it newest, so
+// wear spreads over every sector and a reset at any point leaves either
+// the old sector or the new one whole. A record torn by a reset fails its
+// CRC; it and anything after it are ignored, which loses at most the
+// flush that was under way.
+class StateLog {
+public:
+  static constexpr size_t MaxKeys = 16;
+  static constexpr size_t MaxValueBytes = 48;
+
+  // Reads back the newest values from `flash`, which must span at least two
+  // sectors.
+  explicit StateLog(FlashArea &flash);
+
+  // Copies the value for `key` to `value` and returns true, or returns
+  // false if it's never been set or was saved with a different size.
+  bool get(uint16_t key, void *value, size_t size) const;
+  // Sets the value for `key`, to be written by the next flush(). Returns
+  // false if it's too big or there are already MaxKeys other keys.
+  bool set(uint16_t key, const void *value, size_t size);
+
+  template <typename T> bool get(uint16_t key, T &value) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return get(key, &value, sizeof(value));
+  }
+  template <typename T> bool set(uint16_t key, const T &value) {
+    static_assert(std::is_trivially_copyable_v<T> &&
+                  sizeof(T) <= MaxValueBytes);
+    return set(key, &value, sizeof(value));
+  }
+
+  // Whether anything's been set since the last flush().
+  [[nodiscard]] bool dirty() const { return dirty_; }
+  // Writes everything set since the last flush, moving on to a new sector
+  // if it won't fit.
+  void flush();
+
+private:
+  // Begins each sector; `sequence` is one more than the sector before's,
+  // and `check` its complement, so a header torn by a reset reads as none.
+  struct SectorHeader {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t check;
+  };
+  // Precedes each value, which is padded to a multiple of four bytes.
+  struct RecordHeader {
+    uint16_t key;
+    uint16_t size;
+    uint32_t crc; // of the key, size and value
+  };
+  struct Record;
+  struct Value {
+    uint16_t key;
+    uint16_t size;
+    bool dirty;
+    std::array<uint8_t, MaxValueBytes> bytes;
+  };
+  static constexpr uint32_t Magic = 0x53544c31; // "STL1"
+  static constexpr uint16_t Erased = 0xffff;
+
+  [[nodiscard]] const uint8_t *sector(size_t index) const {
+    return flash_.data() + index * FlashArea::SectorBytes;
+  }
+  [[nodiscard]] Value *find(uint16_t key);
+  [[nodiscard]] const Value *find(uint16_t key) const;
+  // Reads back the records in the newest sector.
+  void replay();
+  // Appends `value` to the current sector.
+  void append(const Value &value);
+  // Moves to the next sector round, copying every value there.
+  void rotate();
+
+  FlashArea &flash_;
+  size_t sectors_;
+  size_t current_ = 0;
+  uint32_t sequence_ = 0;
+  // Where the next record goes in the current sector; SectorBytes once
+  // nothing more may be appended there.
+  size_t end_ = FlashArea::SectorBytes;
+  std::array<Value, MaxKeys> values_{};
+  size_t num_values_ = 0;
+  bool dirty_ = false;
+};
@@ -0,0 +1,57 @@
+#include "stream_inflate.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+int32_t StreamInflater::inflate(const uint8_t *compressed, size_t size,
+                                Transport &out) {
+  return run(compressed, size, TINFL_FLAG_PARSE_ZLIB_HEADER, out);
+}
+
+int32_t StreamInflater::inflate_raw(const uint8_t *compressed, size_t size,
+                                    const uint8_t *dictionary,
+                                    size_t dictionary_size, Transport &out) {
+  if (dictionary_size > dict_.size())
+    return -1;
+  // Decoding starts at the front of the window, so references back into
+  // the dictionary wrap around to its end.
+  out.wait();
+  std::memcpy(dict_.data() + dict_.size() - dictionary_size, dictionary,
+              dictionary_size);
+  return run(compressed, size, 0, out);
+}
+
+int32_t StreamInflater::run(const uint8_t *compressed, size_t size,
+                            uint32_t flags, Transport &out) {
+  tinfl_init(&decompressor_);
+  size_t in_pos = 0;
+  size_t dict_pos = 0;
+  int32_t total = 0;
+  for (;;) {
+    // tinfl only ever writes from dict_pos to the end of the dictionary, so
+    // the piece in flight (just behind dict_pos) is safe until we wrap.
+    if (dict_pos == 0)
+      out.wait();
+    auto in_size = std::min(InputChunk, size - in_pos);
+    const bool more_input = in_pos + in_size < size;
+    auto out_size = dict_.size() - dict_pos;
+    auto status = tinfl_decompress(
+        &decompressor_, compressed + in_pos, &in_size, dict_.data(),
+        dict_.data() + dict_pos, &out_size,
+        flags | (more_input ? TINFL_FLAG_HAS_MORE_INPUT : 0));
+    in_pos += in_size;
+    if (status < TINFL_STATUS_DONE)
+      break;
+    if (out_size) {
+      out.start_data(dict_.data() + dict_pos, out_size);
+      total += static_cast<int32_t>(out_size);
+      dict_pos = (dict_pos + out_size) & (dict_.size() - 1);
+    }
+    if (status == TINFL_STATUS_DONE) {
+      out.wait();
+      return total;
+    }
+  }
+  out.wait();
+  return -1;
+}
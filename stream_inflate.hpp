@@ -0,0 +1,37 @@
+#pragma once
+
+#include "transport.hpp"
+
+#include "miniz.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Inflates a zlib stream straight to a transport, without ever holding the
+// whole frame. tinfl decodes into its 32KB wrapping dictionary and each newly
+// decoded piece is sent as soon as it appears, so the upload of one piece
+// overlaps decoding the next. Costs the ~11KB decompressor and the dictionary
+// rather than a 134KB frame buffer.
+class StreamInflater {
+public:
+  // Compressed input is fed to tinfl this much at a time, which bounds how
+  // much output builds up before it is sent.
+  static constexpr size_t InputChunk = 2048;
+
+  // Inflates a zlib stream. Returns the number of bytes sent, or -1 if the
+  // stream is corrupt or truncated.
+  int32_t inflate(const uint8_t *compressed, size_t size, Transport &out);
+  // Inflates a raw deflate stream compressed against a preset dictionary of
+  // up to 32KB, which is copied into the end of the window first.
+  int32_t inflate_raw(const uint8_t *compressed, size_t size,
+                      const uint8_t *dictionary, size_t dictionary_size,
+                      Transport &out);
+
+private:
+  int32_t run(const uint8_t *compressed, size_t size, uint32_t flags,
+              Transport &out);
+
+  tinfl_decompressor decompressor_;
+  alignas(4) std::array<uint8_t, TINFL_LZ_DICT_SIZE> dict_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "hardware/clocks.h"
+#include "pico/stdlib.h" // NOLINT(modernize-deprecated-headers)
+
+#include <cstdint>
+
+#ifndef SYS_CLK_KHZ
+#define SYS_CLK_KHZ 125000
+#endif
+
+// Short waits for the panel's setup and hold times. These count real clk_sys
+// cycles rather than assuming a fixed time per nop, so they stay right (and
+// no longer than needed) if the clock is raised or lowered. Anything long
+// enough to be worth it is handed to the hardware timer instead.
+namespace timing {
+
+// Waits at least this long use the microsecond timer rather than cycles.
+constexpr uint32_t TimerThresholdNs = 10'000;
+
+constexpr uint32_t cycles_for_ns(uint32_t nanos, uint32_t hz) {
+  return static_cast<uint32_t>(
+      (static_cast<uint64_t>(nanos) * hz + 999'999'999u) / 1'000'000'000u);
+}
+
+#ifdef FRAME_FIXED_SYS_CLK
+// clk_sys is never changed from the SDK's boot setting, so cycle counts fold
+// down to constants.
+constexpr uint32_t sys_clk_hz() { return SYS_CLK_KHZ * 1000u; }
+#else
+inline uint32_t sys_clk_hz() { return clock_get_hz(clk_sys); }
+#endif
+
+inline void delay_ns(uint32_t nanos) {
+  if (nanos >= TimerThresholdNs)
+    busy_wait_us_32((nanos + 999) / 1000);
+  else
+    busy_wait_at_least_cycles(cycles_for_ns(nanos, sys_clk_hz()));
+}
+
+template <uint32_t Nanos> inline void delay_ns() {
+  if constexpr (Nanos >= TimerThresholdNs) {
+    busy_wait_us_32((Nanos + 999) / 1000);
+  } else {
+    busy_wait_at_least_cycles(cycles_for_ns(Nanos, sys_clk_hz()));
+  }
+}
+
+} // namespace timing
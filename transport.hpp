@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Gets bytes to the e-ink controller. Every call is its own chip-select framed
+// transaction, with DC low for commands and high for data; how the bytes
+// actually move (CPU, DMA, or a host-side recorder) is up to the
+// implementation.
+class Transport {
+public:
+  virtual ~Transport() = default;
+
+  // Sends a command byte followed by its parameters, all under one chip
+  // select with DC flipped high after the command byte.
+  virtual void command(uint8_t command, const uint8_t *params,
+                       size_t length) = 0;
+  // Sends every command in a table built by `command_table()`, each in its
+  // own chip select. Transports that can queue the lot in one go override it.
+  virtual void commands(const uint8_t *table, size_t size) {
+    for (size_t pos = 0; pos + 2 <= size; pos += 2 + table[pos + 1])
+      command(table[pos], table + pos + 2, table[pos + 1]);
+  }
+
+  // Starts sending `length` bytes of data and returns straight away. `data`
+  // must stay alive and unmodified until `wait()` returns. Starting a new
+  // transaction first waits for any in-flight one.
+  virtual void start_data(const uint8_t *data, size_t length) = 0;
+  // As `start_data()`, but sends `value` `length` times without the caller
+  // (or, where possible, the CPU) touching each byte.
+  virtual void start_fill(uint8_t value, size_t length) = 0;
+  // Holds chip select across the `start_data()` and `start_fill()` calls up
+  // to `close_data()`, so they reach the panel as a single data transaction.
+  // Transports that can't keep a frame open may frame each call separately,
+  // which the controller also accepts.
+  virtual void open_data() {}
+  virtual void close_data() {}
+  // True while a transfer started by `start_data()` is still going.
+  [[nodiscard]] virtual bool busy() const = 0;
+  // Blocks until the in-flight transfer (if any) has finished and the chip
+  // select has been released (unless a frame is open, in which case the
+  // buffer is simply free again). Implementations should let the core sleep.
+  virtual void wait() = 0;
+
+  void command(uint8_t command) { this->command(command, nullptr, 0); }
+  void data(const uint8_t *data, size_t length) {
+    start_data(data, length);
+    wait();
+  }
+  void fill(uint8_t value, size_t length) {
+    start_fill(value, length);
+    wait();
+  }
+};
@@ -0,0 +1,150 @@
+#include "xip_stream.hpp"
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "hardware/dma.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "pico/mutex.h"
+
+#include <algorithm>
+
+namespace {
+
+auto_init_mutex(engine);
+
+// The flash behind the cached XIP alias, as the uncached one that doesn't
+// allocate either, for the odd bytes streaming can't reach.
+const uint8_t *uncached(const uint8_t *data) {
+  return data + (XIP_NOCACHE_NOALLOC_BASE - XIP_BASE);
+}
+
+} // namespace
+
+XipStream::XipStream()
+    : claimed_(mutex_try_enter(&engine, nullptr)),
+      channel_(dma_claim_unused_channel(true)) {}
+
+XipStream::~XipStream() {
+  wait();
+  dma_channel_unclaim(static_cast<uint>(channel_));
+  if (claimed_)
+    mutex_exit(&engine);
+}
+
+bool XipStream::streamable(const void *data) {
+  const auto address = reinterpret_cast<uintptr_t>(data);
+  return address >= XIP_BASE && address < XIP_NOALLOC_BASE;
+}
+
+const uint8_t *XipStream::start(const uint8_t *from, size_t size,
+                                uint32_t *to) {
+  const auto skip = reinterpret_cast<uintptr_t>(from) & 3;
+  start_words(reinterpret_cast<const uint32_t *>(from - skip), to,
+              (skip + size + 3) / 4);
+  return reinterpret_cast<const uint8_t *>(to) + skip;
+}
+
+void XipStream::start_words(const uint32_t *from, uint32_t *to,
+                            size_t words) {
+  const auto channel = static_cast<uint>(channel_);
+  // Anything a previous read left in the FIFO would come out first.
+  while (!(xip_ctrl_hw->stat & XIP_STAT_FIFO_EMPTY_BITS))
+    (void)xip_ctrl_hw->stream_fifo;
+  xip_ctrl_hw->stream_addr = reinterpret_cast<uintptr_t>(from);
+  xip_ctrl_hw->stream_ctr = words;
+  auto config = dma_channel_get_default_config(channel);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+  channel_config_set_read_increment(&config, false);
+  channel_config_set_write_increment(&config, to != nullptr);
+  channel_config_set_dreq(&config, DREQ_XIP_STREAM);
+  channel_config_set_sniff_enable(&config, true);
+  static uint32_t sink;
+  // XIP_AUX_BASE reads the FIFO without waiting on the XIP bus.
+  dma_channel_configure(channel, &config, to ? to : &sink,
+                        reinterpret_cast<const void *>(XIP_AUX_BASE), words,
+                        true);
+}
+
+void XipStream::wait() {
+  dma_channel_wait_for_finish_blocking(static_cast<uint>(channel_));
+}
+
+uint32_t XipStream::crc32(const uint8_t *data, size_t size) {
+  // CRC32R feeds each byte in LSB first, as zlib does; zlib's result is
+  // then the accumulator bit-reversed and inverted, which the sniffer does
+  // as it's read. Nothing else uses the sniffer. Words go in a byte at a
+  // time from the least significant, so in memory order.
+  const auto channel = static_cast<uint>(channel_);
+  dma_sniffer_enable(channel, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+  hw_set_bits(&dma_hw->sniff_ctrl,
+              DMA_SNIFF_CTRL_OUT_REV_BITS | DMA_SNIFF_CTRL_OUT_INV_BITS);
+  dma_hw->sniff_data = 0xffffffff;
+
+  auto config = dma_channel_get_default_config(channel);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+  channel_config_set_read_increment(&config, true);
+  channel_config_set_write_increment(&config, false);
+  channel_config_set_sniff_enable(&config, true);
+  static uint8_t sink;
+  const auto read = [&](const uint8_t *from, size_t bytes) {
+    if (bytes) {
+      dma_channel_configure(channel, &config, &sink, from, bytes, true);
+      wait();
+    }
+  };
+  if (claimed_ && streamable(data)) {
+    // The whole words go through the engine, and the bytes either side
+    // uncached.
+    const auto address = reinterpret_cast<uintptr_t>(data);
+    const auto head = std::min<size_t>(-address & 3, size);
+    const auto words = (size - head) / 4;
+    read(uncached(data), head);
+    if (words) {
+      start_words(reinterpret_cast<const uint32_t *>(data + head), nullptr,
+                  words);
+      wait();
+    }
+    read(uncached(data + head + words * 4), size - head - words * 4);
+  } else {
+    read(data, size);
+  }
+  const uint32_t crc = dma_hw->sniff_data;
+  dma_sniffer_disable();
+  return crc;
+}
+#else
+#include "miniz.h"
+
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+std::atomic_flag engine = ATOMIC_FLAG_INIT;
+
+} // namespace
+
+XipStream::XipStream() : claimed_(!engine.test_and_set()) {}
+
+XipStream::~XipStream() {
+  if (claimed_)
+    engine.clear();
+}
+
+// Everything counts, so the host benches exercise the staging.
+bool XipStream::streamable(const void *) { return true; }
+
+const uint8_t *XipStream::start(const uint8_t *from, size_t size,
+                                uint32_t *to) {
+  auto *bytes = reinterpret_cast<uint8_t *>(to) +
+                (reinterpret_cast<uintptr_t>(from) & 3);
+  std::memcpy(bytes, from, size);
+  return bytes;
+}
+
+void XipStream::wait() {}
+
+uint32_t XipStream::crc32(const uint8_t *data, size_t size) {
+  return static_cast<uint32_t>(mz_crc32(MZ_CRC32_INIT, data, size));
+}
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The XIP streaming engine, which reads flash into a FIFO for DMA to empty
+// without going through the XIP cache, so a bulk read of image data neither
+// stalls on cache misses nor evicts the code running from flash. There's
+// one, shared by the cores. The host build copies with memcpy instead.
+class XipStream {
+public:
+  // Claims the engine, unless the other core has it; see claimed().
+  XipStream();
+  // Waits for any copy, then releases the engine.
+  ~XipStream();
+  XipStream(const XipStream &) = delete;
+  XipStream &operator=(const XipStream &) = delete;
+
+  [[nodiscard]] bool claimed() const { return claimed_; }
+  // Whether `data` is read through the XIP cache, so worth streaming.
+  static bool streamable(const void *data);
+
+  // Starts copying `size` bytes from `from`, which must be streamable, to
+  // `to`, which needs room for size + 3: the engine reads whole words, so
+  // they land as far into it as `from` is into its word. Returns where they
+  // land. One copy at a time, and only once claimed.
+  const uint8_t *start(const uint8_t *from, size_t size, uint32_t *to);
+  // Waits for the copy to finish.
+  void wait();
+
+  // zlib's CRC-32 of `size` bytes at `data`, from the DMA sniffer. Streams
+  // the data if it can, and otherwise reads it in place.
+  uint32_t crc32(const uint8_t *data, size_t size);
+
+private:
+  void start_words(const uint32_t *from, uint32_t *to, size_t words);
+
+  bool claimed_ = false;
+  int channel_ = -1;
+};